@@ -0,0 +1,126 @@
+#pragma once
+
+#include "serial_interface.hpp"
+#include "thread_tuning.hpp"
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+
+namespace hw_analyzer {
+
+// On-disk capture format
+//
+//   FileHeader | Block 0 | Block 1 | ... | Index | Footer
+//
+// Each block is a BlockHeader followed by its payload, compressed on its own
+// so any block can be decoded without touching its neighbours. Inside a
+// block, consecutive read batches of one channel share a group header, and
+// each batch keeps its own timestamps. The index at
+// the end lists every block with its offset and time range; if the footer is
+// missing (capture interrupted) the reader rebuilds the index by walking the
+// block headers. All integers are little-endian.
+
+enum class CaptureCodec : uint8_t {
+    None = 0,
+    LZ4 = 1,  // Fast, for live capture
+    Zstd = 2  // Higher ratio, for archiving
+};
+
+// One read batch
+struct CaptureRecord {
+    RxTimestamp ts;
+    uint16_t channel = 0;
+    std::string data;
+};
+
+struct CaptureBlockInfo {
+    uint64_t offset = 0;      // File offset of the block header
+    uint32_t rawSize = 0;
+    uint32_t compressedSize = 0;
+    uint32_t recordCount = 0;
+    CaptureCodec codec = CaptureCodec::None;
+    uint64_t firstNs = 0;     // Earliest record wakeup time in the block
+    uint64_t lastNs = 0;      // Latest record wakeup time in the block
+    uint64_t firstRecord = 0; // Index of the first record in the capture
+};
+
+class CaptureWriter {
+public:
+    struct Stats {
+        uint64_t records = 0;
+        uint64_t rawBytes = 0;        // Record bytes handed to compression
+        uint64_t writtenBytes = 0;    // Bytes written to the file
+        uint64_t droppedRecords = 0;  // Dropped because compression fell behind or a write failed
+        uint64_t blocks = 0;
+        bool writeError = false;      // A write failed; later blocks were dropped
+    };
+
+    CaptureWriter();
+    ~CaptureWriter();
+
+    static bool codecAvailable(CaptureCodec codec);
+    static bool parseCodec(const std::string& name, CaptureCodec& codec);
+
+    // Applied to the compression thread on the next open()
+    void setThreadPlacement(const ThreadPlacement& placement);
+
+    // Path "-" writes to stdout. blockSize is the uncompressed size at which
+    // a block is sealed and handed to the compression thread.
+    bool open(const std::string& path, CaptureCodec codec = CaptureCodec::LZ4,
+              size_t blockSize = 256 * 1024);
+    void close();
+    bool isOpen() const;
+
+    // Called from the capture path: copies the record into its channel's
+    // staging group or the current block and never waits on compression or
+    // disk I/O. Blocks come from a pool allocated in open(); while none is
+    // free, records are dropped.
+    void append(const std::string& data, const RxTimestamp& ts, uint16_t channel = 0);
+
+    // Seal the current block even if it is not full
+    void flush();
+
+    Stats stats() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl;
+};
+
+class CaptureReader {
+public:
+    using RecordCallback = std::function<bool(const CaptureRecord&)>; // return false to stop
+
+    CaptureReader() = default;
+    ~CaptureReader();
+
+    bool open(const std::string& path);
+    void close();
+
+    const std::vector<CaptureBlockInfo>& blocks() const { return blocks_; }
+
+    // Decompress a single block
+    bool readBlock(size_t index, std::vector<CaptureRecord>& out);
+
+    // Visit records with fromNs <= wakeup <= toNs, decoding only the blocks
+    // whose time range overlaps the window.
+    bool replay(uint64_t fromNs, uint64_t toNs, const RecordCallback& cb);
+
+    // Visit records in the window in which a match of needle starts. Matches
+    // may continue into later records of the same channel; such a record is
+    // visited once the match completes.
+    bool search(const std::string& needle, uint64_t fromNs, uint64_t toNs,
+                const RecordCallback& cb);
+
+private:
+    bool readIndex();
+    bool scanBlocks();
+
+    std::FILE* file_ = nullptr;
+    std::vector<CaptureBlockInfo> blocks_;
+};
+
+} // namespace hw_analyzer
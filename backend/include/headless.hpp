@@ -0,0 +1,51 @@
+#pragma once
+
+#include "capture_file.hpp"
+#include "thread_tuning.hpp"
+#include <string>
+#include <vector>
+
+namespace hw_analyzer {
+
+// Unattended capture without the WebSocket server:
+//
+//   hw_analyzer_backend --headless --port /dev/ttyUSB0[:BAUD] [--port ...]
+//       [--baud N] [--data-bits 5-8] [--parity N|E|O] [--stop-bits 1|2]
+//       [--output FILE|-] [--format capture|raw] [--codec lz4|zstd|none]
+//       [--trigger TEXT] [--stop-trigger TEXT] [--duration SEC]
+//       [--stats-interval SEC]
+//       [--reader-cpu N[,N...]] [--publisher-cpu N] [--rt-priority N] [--mlock]
+//
+// Each port is read by its own thread and written straight to the output,
+// tagged with its channel (the port's position on the command line).
+// Statistics go to stderr so stdout can carry the capture.
+
+struct HeadlessPort {
+    std::string name;
+    int baud = 0; // 0: use HeadlessOptions::baud
+};
+
+struct HeadlessOptions {
+    std::vector<HeadlessPort> ports;
+    int baud = 115200;
+    int dataBits = 8;
+    char parity = 'N';
+    int stopBits = 1;
+
+    std::string output = "-";
+    bool rawOutput = false;       // Raw bytes instead of the capture format
+    CaptureCodec codec = CaptureCodec::LZ4;
+
+    std::string startTrigger;     // Discard data until this text is seen
+    std::string stopTrigger;      // Finish once this text is seen
+    double duration = 0;          // Seconds; 0 runs until SIGINT/SIGTERM
+    double statsInterval = 5;     // Seconds; 0 disables the summary
+
+    TuningOptions tuning;         // Publisher CPU applies to the capture writer
+};
+
+bool isHeadless(int argc, char* argv[]);
+bool parseHeadlessArgs(int argc, char* argv[], HeadlessOptions& options, std::string& error);
+int runHeadless(const HeadlessOptions& options);
+
+} // namespace hw_analyzer
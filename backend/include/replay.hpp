@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+namespace hw_analyzer {
+
+// Offline access to a capture file:
+//
+//   hw_analyzer_backend --replay FILE [--from SEC] [--to SEC]
+//       [--search TEXT] [--channel N] [--format text|raw] [--info]
+//
+// Times are seconds from the first record in the capture. Only blocks whose
+// time range overlaps the window are decompressed. Text output prints one
+// record per line (time, channel, escaped payload); raw output writes the
+// payload bytes only. --info prints the block index to stderr.
+
+struct ReplayOptions {
+    std::string path;
+    double from = 0;         // Seconds from the start of the capture
+    double to = -1;          // Negative: until the end
+    std::string search;      // Only records containing this text
+    int channel = -1;        // Negative: all channels
+    bool rawOutput = false;
+    bool info = false;
+};
+
+bool isReplay(int argc, char* argv[]);
+bool parseReplayArgs(int argc, char* argv[], ReplayOptions& options, std::string& error);
+int runReplay(const ReplayOptions& options);
+
+} // namespace hw_analyzer
@@ -2,10 +2,12 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 #include <thread>
 #include <atomic>
 #include <functional>
 #include <memory>
+#include "thread_tuning.hpp"
 
 namespace hw_analyzer {
 
@@ -15,9 +17,35 @@ struct SerialPortInfo {
     std::string manufacturer;
 };
 
+// Timing of one read batch. All values are CLOCK_MONOTONIC_RAW nanoseconds
+// (QueryPerformanceCounter on Windows), so they are comparable across batches
+// but not with wall-clock time.
+struct RxTimestamp {
+    uint64_t wakeupNs = 0;    // When the reader woke up with this batch pending
+    uint64_t firstByteNs = 0; // Estimated arrival of the first byte in the batch
+    uint32_t byteTimeNs = 0;  // Wire time of one character at the current line settings
+
+    // Estimated arrival time of byte i within the batch
+    uint64_t byteNs(size_t i) const { return firstByteNs + i * byteTimeNs; }
+};
+
+struct SerialStats {
+    uint64_t bytes = 0;    // Bytes delivered by the read loop
+    uint64_t batches = 0;  // Reads that returned data
+    int64_t overruns = -1; // UART FIFO + driver buffer overruns; -1 if unavailable
+
+    // Reader wakeup jitter: how late the read thread wakes after a timed
+    // wait, either its idle poll timeout or, under sustained traffic, a short
+    // sleep taken every 100 ms. This is the scheduling latency a data wakeup
+    // also sees.
+    uint64_t jitterSamples = 0;
+    uint64_t jitterAvgNs = 0;
+    uint64_t jitterMaxNs = 0;
+};
+
 class SerialInterface {
 public:
-    using DataCallback = std::function<void(const std::string&)>;
+    using DataCallback = std::function<void(const std::string&, const RxTimestamp&)>;
     using ErrorCallback = std::function<void(const std::string&)>;
 
     SerialInterface();
@@ -25,10 +53,14 @@ public:
 
     // Port management
     static std::vector<SerialPortInfo> listPorts();
+
+    // Monotonic raw clock used for all RX timestamps
+    static uint64_t monotonicNs();
     
     bool open(const std::string& portName, int baudRate = 115200);
     void close();
     bool isOpen() const;
+    std::string portName() const;
 
     // Data operations
     bool write(const std::string& data);
@@ -39,6 +71,12 @@ public:
     void setErrorCallback(ErrorCallback cb);
     void startReadLoop();
     void stopReadLoop();
+    // False once the read loop has stopped, including after a disconnect
+    bool isReading() const;
+    SerialStats stats() const;
+
+    // Applied by the read thread when it starts
+    void setThreadPlacement(const ThreadPlacement& placement);
 
     // Configuration
     bool setBaudRate(int baudRate);
@@ -47,6 +85,8 @@ public:
     bool setStopBits(int bits);
 
 private:
+    bool reopen();
+
     class Impl;
     std::unique_ptr<Impl> pImpl;
 };
@@ -0,0 +1,12 @@
+#pragma once
+
+namespace hw_analyzer {
+
+#ifdef __linux__
+// Sets an arbitrary baud rate through termios2/BOTHER. Kept in its own
+// translation unit because <asm/termbits.h> clashes with <termios.h>.
+// Returns false if the driver rejects the rate.
+bool setLinuxCustomBaud(int fd, int baudRate);
+#endif
+
+} // namespace hw_analyzer
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "serial_interface.hpp"
+#include <string>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+
+namespace hw_analyzer {
+
+// Shared-memory RX ring for a local consumer (the Electron main process).
+//
+// The backend creates a POSIX shared memory object laid out as a
+// ShmRingHeader followed by a power-of-two data area. Records are appended by
+// a single producer; the consumer advances readPos when done. Positions only
+// grow, the data offset is pos & (capacity - 1).
+//
+// Each record is a 32-byte ShmRecordHeader plus payload, padded to 8 bytes.
+// A record never wraps: if it does not fit before the end of the data area,
+// the producer fills the tail with a padding record (or leaves it empty if
+// it is shorter than a header) and starts again at offset 0.
+//
+// Doorbell: after publishing, the producer increments `doorbell` and issues a
+// futex wake only when `waiters` is non-zero. A consumer that found the ring
+// empty increments `waiters`, re-checks, and futex-waits on `doorbell`. While
+// the consumer is busy no syscalls are made per record. On platforms without
+// futex the consumer polls.
+//
+// When the consumer falls behind by more than the capacity, new records are
+// dropped and counted; the producer never waits.
+//
+// tools/shm_ring_reader.hpp implements the consumer side of this protocol.
+
+struct ShmRingHeader {
+    char magic[8];                  // "HWARING1"
+    uint32_t version;
+    uint32_t headerSize;            // Offset of the data area
+    uint64_t capacity;              // Data area size in bytes
+    uint8_t reserved0[40];
+
+    alignas(64) std::atomic<uint64_t> writePos;
+    std::atomic<uint32_t> doorbell; // futex word
+    std::atomic<uint32_t> waiters;
+    std::atomic<uint64_t> dropped;
+    uint8_t reserved1[40];
+
+    alignas(64) std::atomic<uint64_t> readPos; // Written by the consumer
+    uint8_t reserved2[56];
+};
+
+struct ShmRecordHeader {
+    uint32_t size;        // Whole record including header and padding
+    uint32_t length;      // Payload bytes
+    uint16_t channel;
+    uint16_t flags;       // kShmRecordPadding for filler records
+    uint32_t byteTimeNs;
+    uint64_t wakeupNs;
+    uint64_t firstByteNs;
+};
+
+const char kShmRingMagic[8] = {'H', 'W', 'A', 'R', 'I', 'N', 'G', '1'};
+const uint32_t kShmRingVersion = 1;
+const uint16_t kShmRecordPadding = 1;
+const size_t kShmRingMaxCapacity = size_t(1) << 30; // 1 GiB
+// A record may take at most half the ring, so the ring must hold two of the
+// largest read batches (4096 bytes)
+const size_t kShmRingMinCapacity = 2 * (4096 + 32);
+
+static_assert(sizeof(ShmRingHeader) == 192, "ShmRingHeader layout is shared with the consumer");
+static_assert(sizeof(ShmRecordHeader) == 32, "ShmRecordHeader layout is shared with the consumer");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Ring positions must be lock-free across processes");
+
+class ShmRing {
+public:
+    ShmRing() = default;
+    ~ShmRing();
+
+    ShmRing(const ShmRing&) = delete;
+    ShmRing& operator=(const ShmRing&) = delete;
+
+    // Create (or replace) the shared memory object. capacity is rounded up
+    // to a power of two; less than kShmRingMinCapacity or more than
+    // kShmRingMaxCapacity is rejected.
+    bool create(const std::string& name, size_t capacity = 16 * 1024 * 1024);
+
+    // Unlink rings named prefix + pid whose backend process no longer
+    // exists, e.g. after it was killed. Linux only.
+    static void removeStale(const std::string& prefix);
+
+    void close();
+    bool isOpen() const;
+
+    const std::string& name() const { return name_; }
+    size_t capacity() const { return capacity_; }
+    uint64_t dropped() const;
+
+    // Copy one RX batch into the ring. Returns false if it was dropped.
+    bool write(const std::string& data, const RxTimestamp& ts, uint16_t channel = 0);
+
+private:
+    mutable std::mutex mutex_;
+    std::string name_;
+    ShmRingHeader* header_ = nullptr;
+    uint8_t* data_ = nullptr;
+    size_t capacity_ = 0;
+    size_t mappedSize_ = 0;
+};
+
+} // namespace hw_analyzer
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace hw_analyzer {
+
+// Where and how a latency-sensitive thread runs
+struct ThreadPlacement {
+    int cpu = -1;         // Pin to this CPU; -1 leaves placement to the OS
+    int fifoPriority = 0; // SCHED_FIFO priority 1-99; 0 keeps normal scheduling
+};
+
+// Command-line tuning shared by the WebSocket and headless modes:
+//   --reader-cpu N[,N...]  CPU per port reader (one value applies to all)
+//   --publisher-cpu N      CPU for the publisher / capture writer thread
+//   --rt-priority N        SCHED_FIFO priority for the port readers
+//   --mlock                Lock memory so the RX path never page-faults
+struct TuningOptions {
+    std::vector<int> readerCpus;
+    int publisherCpu = -1;
+    int rtPriority = 0;
+    bool lockMemory = false;
+
+    ThreadPlacement reader(size_t index) const;
+    ThreadPlacement publisher() const;
+};
+
+// Returns true if arg is a tuning flag. Flags other than --mlock take a
+// value; *consumedValue is set when it was used. On a bad value, error is set.
+bool parseTuningOption(const std::string& arg, const char* value, TuningOptions& options,
+                       bool* consumedValue, std::string& error);
+
+// Apply to the calling thread; failures (e.g. missing CAP_SYS_NICE) are
+// reported on stderr and leave the thread as it was.
+bool applyThreadPlacement(const ThreadPlacement& placement, const std::string& name);
+
+// mlockall() plus allocator settings that keep freed memory mapped
+bool lockProcessMemory();
+bool processMemoryLocked();
+
+// Touch the calling thread's stack so later calls do not fault it in
+void prefaultStack();
+
+} // namespace hw_analyzer
@@ -5,11 +5,23 @@
 #include <thread>
 #include <atomic>
 #include <vector>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <regex>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 
+#ifdef HW_ANALYZER_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "thread_tuning.hpp"
+
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
@@ -18,7 +30,9 @@
 #pragma comment(lib, "crypt32.lib")
 #else
 #include <sys/socket.h>
+#include <sys/select.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <openssl/sha.h>
@@ -29,9 +43,164 @@
 
 namespace hw_analyzer {
 
+// permessage-deflate (RFC 7692) settings
+struct CompressionOptions {
+    enum class Mode {
+        Off,       // Never negotiate
+        Requested, // Only for clients connecting with "?compress" in the URL
+        Always     // Whenever the client offers it
+    };
+
+    Mode mode = Mode::Requested;
+    size_t minFrameSize = 256;  // Smaller messages are sent uncompressed
+    int level = 1;              // zlib level; low to keep the broadcast path cheap
+    bool contextTakeover = true; // false: declare server_no_context_takeover for every client
+};
+
+// A message for subscribers, with the attributes filters match against
+struct Publication {
+    std::string type;   // "rx", "error", ...
+    std::string port;   // Source port, empty if not port-specific
+    int channel = 0;
+    std::string data;   // Raw payload seen by byte-range and regex filters
+    std::string json;   // Serialized message sent to matching clients
+};
+
+// What a client wants to receive. Empty lists match everything.
+struct Subscription {
+    std::vector<std::string> types;
+    std::vector<std::string> ports;
+    std::vector<int> channels;
+    int byteMin = -1;   // With byteMax: payload must contain a byte in [byteMin, byteMax]
+    int byteMax = -1;
+    std::string regex;  // Current line must contain a match (ECMAScript syntax)
+
+    static constexpr size_t kMaxRegexLength = 256;
+
+    // Validates the filter and prepares it for matching
+    bool compile(std::string& error) {
+        key_.clear();
+        if ((byteMin >= 0) != (byteMax >= 0) || byteMin > byteMax || byteMax > 255) {
+            error = "Invalid byte range";
+            return false;
+        }
+        hasRegex_ = !regex.empty();
+        if (hasRegex_) {
+            if (regex.size() > kMaxRegexLength) {
+                error = "Regex too long";
+                return false;
+            }
+            if (!regexIsSimple(regex)) {
+                error = "Regex too complex: no backreferences, and no repeated groups that contain a quantifier or |";
+                return false;
+            }
+            try {
+                compiled_ = std::regex(regex, std::regex::ECMAScript | std::regex::optimize);
+            } catch (const std::regex_error&) {
+                error = "Invalid regex";
+                return false;
+            }
+        }
+
+        // Canonical form so clients with identical filters share one evaluation
+        std::sort(types.begin(), types.end());
+        std::sort(ports.begin(), ports.end());
+        std::sort(channels.begin(), channels.end());
+        std::ostringstream key;
+        for (const auto& t : types) key << "t" << t.size() << ":" << t;
+        for (const auto& p : ports) key << "p" << p.size() << ":" << p;
+        for (int c : channels) key << "c" << c << ";";
+        key << "b" << byteMin << "," << byteMax;
+        key_ = key.str();
+        return true;
+    }
+
+    // Identifies the attribute filters; the regex is not part of it
+    const std::string& key() const { return key_; }
+
+    bool hasRegex() const { return hasRegex_; }
+
+    // Every filter except the regex, which is applied per client by
+    // matchesText()
+    bool matchesAttributes(const Publication& pub) const {
+        if (!types.empty() && !std::binary_search(types.begin(), types.end(), pub.type)) return false;
+        // Messages without a port (e.g. backend errors) pass port filters
+        if (!ports.empty() && !pub.port.empty() &&
+            !std::binary_search(ports.begin(), ports.end(), pub.port)) return false;
+        if (!channels.empty() && !std::binary_search(channels.begin(), channels.end(), pub.channel)) return false;
+        if (byteMin >= 0) {
+            bool found = std::any_of(pub.data.begin(), pub.data.end(), [this](char c) {
+                int b = static_cast<uint8_t>(c);
+                return b >= byteMin && b <= byteMax;
+            });
+            if (!found) return false;
+        }
+        return true;
+    }
+
+    // True if the regex matches text somewhere ending after offset `from`,
+    // so a match found in earlier text is not reported again
+    bool matchesText(const std::string& text, size_t from) const {
+        if (!hasRegex_) return true;
+        for (std::sregex_iterator it(text.begin(), text.end(), compiled_), end; it != end; ++it) {
+            if (static_cast<size_t>(it->position() + it->length()) > from) return true;
+        }
+        return false;
+    }
+
+private:
+    // Rejects the constructs that make backtracking exponential: a repeated
+    // group that itself contains a quantifier or an alternation, e.g. (a*)*
+    // or (a|b)*, and backreferences.
+    static bool regexIsSimple(const std::string& pattern) {
+        std::vector<bool> groupHasRepeat; // Open groups: contains a quantifier or |
+        bool lastWasRiskyGroup = false;   // Previous atom is such a group
+        for (size_t i = 0; i < pattern.size(); i++) {
+            char c = pattern[i];
+            bool riskyGroup = false;
+            if (c == '\\') {
+                if (i + 1 < pattern.size() && pattern[i + 1] >= '1' && pattern[i + 1] <= '9') return false;
+                i++;
+            } else if (c == '[') {
+                // Skip the class; ']' right after '[' or '[^' is literal
+                size_t j = i + 1;
+                if (j < pattern.size() && pattern[j] == '^') j++;
+                if (j < pattern.size() && pattern[j] == ']') j++;
+                while (j < pattern.size() && pattern[j] != ']') {
+                    if (pattern[j] == '\\') j++;
+                    j++;
+                }
+                i = j;
+            } else if (c == '(') {
+                groupHasRepeat.push_back(false);
+                if (i + 1 < pattern.size() && pattern[i + 1] == '?') i++; // (?: (?= (?!
+            } else if (c == ')') {
+                if (groupHasRepeat.empty()) return false;
+                riskyGroup = groupHasRepeat.back();
+                groupHasRepeat.pop_back();
+                if (riskyGroup && !groupHasRepeat.empty()) groupHasRepeat.back() = true;
+            } else if (c == '*' || c == '+' || c == '?' || c == '{' || c == '|') {
+                if (lastWasRiskyGroup && c != '|') return false;
+                if (!groupHasRepeat.empty()) groupHasRepeat.back() = true;
+                if (c == '{') {
+                    while (i < pattern.size() && pattern[i] != '}') i++;
+                }
+            }
+            lastWasRiskyGroup = riskyGroup;
+        }
+        return true;
+    }
+
+    std::string key_;
+    bool hasRegex_ = false;
+    std::regex compiled_;
+};
+
 class WebSocketServer {
 public:
-    using MessageHandler = std::function<std::string(const std::string&)>;
+    // clientId identifies the connection for per-client calls such as setSubscription()
+    using MessageHandler = std::function<std::string(int clientId, const std::string&)>;
+    using DisconnectHandler = std::function<void(int clientId)>;
 
     WebSocketServer(int port) : port_(port) {
 #ifdef _WIN32
@@ -42,6 +211,9 @@ public:
 
     ~WebSocketServer() {
         stop();
+        if (publisher_.joinable()) {
+            publisher_.join();
+        }
 #ifdef _WIN32
         WSACleanup();
 #endif
@@ -51,8 +223,27 @@ public:
         messageHandler_ = std::move(handler);
     }
 
+    // Called on the client's thread after it left the client list and
+    // before its socket is closed, so the id cannot have been reused yet
+    void setDisconnectHandler(DisconnectHandler handler) {
+        disconnectHandler_ = std::move(handler);
+    }
+
+    void setCompression(const CompressionOptions& options) {
+        compression_ = options;
+    }
+
+    // Applied to the publisher thread when run() starts it
+    void setPublisherPlacement(const ThreadPlacement& placement) {
+        publisherPlacement_ = placement;
+    }
+
     void run() {
         running_ = true;
+        publisher_ = std::thread([this]() {
+            applyThreadPlacement(publisherPlacement_, "publisher");
+            publishLoop();
+        });
         
         int serverSocket = socket(AF_INET, SOCK_STREAM, 0);
         if (serverSocket < 0) {
@@ -95,6 +286,13 @@ public:
         std::cout << "WebSocket server listening on port " << port_ << std::endl;
 
         while (running_) {
+            // Wake up periodically so stop() ends the loop
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(serverSocket, &readable);
+            timeval timeout{0, 200000};
+            if (select(serverSocket + 1, &readable, nullptr, nullptr, &timeout) <= 0) continue;
+
             sockaddr_in clientAddr{};
 #ifdef _WIN32
             int clientLen = sizeof(clientAddr);
@@ -128,15 +326,57 @@ public:
 #endif
     }
 
+    // Makes run() return; connected clients are not closed
     void stop() {
-        running_ = false;
+        {
+            std::lock_guard<std::mutex> lock(publishMutex_);
+            running_ = false;
+        }
+        publishCv_.notify_all();
+    }
+
+    // Queue a message for subscribed clients. Never blocks on the network:
+    // the publisher thread delivers queued messages in batches.
+    void publish(Publication pub) {
+        auto shared = std::make_shared<const Publication>(std::move(pub));
+        {
+            std::lock_guard<std::mutex> lock(publishMutex_);
+            if (publishQueue_.size() >= kMaxQueuedPublications) {
+                droppedPublications_++;
+                return;
+            }
+            publishQueue_.push_back(std::move(shared));
+        }
+        publishCv_.notify_one();
+    }
+
+    uint64_t droppedPublications() const { return droppedPublications_; }
+
+    // Messages not sent because a client's outbox or regex queue was full
+    uint64_t droppedFrames() const { return droppedFrames_; }
+
+    // Replace a client's filter; returns false if the client is gone
+    bool setSubscription(int clientId, const Subscription& subscription) {
+        std::lock_guard<std::mutex> lock(clientsMutex_);
+        for (auto& client : clients_) {
+            if (client->socket == clientId) {
+                client->subscription = std::make_shared<const Subscription>(subscription);
+                return true;
+            }
+        }
+        return false;
     }
 
-    void broadcast(const std::string& message) {
+    // Current filter of a client; returns false if the client is gone
+    bool getSubscription(int clientId, Subscription& subscription) const {
         std::lock_guard<std::mutex> lock(clientsMutex_);
-        for (int client : clients_) {
-            sendWebSocketFrame(client, message);
+        for (const auto& client : clients_) {
+            if (client->socket == clientId) {
+                subscription = *client->subscription;
+                return true;
+            }
         }
+        return false;
     }
 
 private:
@@ -220,6 +460,245 @@ private:
 #endif
     }
 
+#ifdef HW_ANALYZER_HAVE_ZLIB
+    // Raw deflate stream for one direction of a permessage-deflate connection
+    class Deflater {
+    public:
+        Deflater(int level, int windowBits) {
+            ok_ = deflateInit2(&zs_, level, Z_DEFLATED, -windowBits, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        }
+        ~Deflater() { if (ok_) deflateEnd(&zs_); }
+        Deflater(const Deflater&) = delete;
+        Deflater& operator=(const Deflater&) = delete;
+
+        bool compress(const std::string& in, std::string& out, bool resetAfter) {
+            if (!ok_) return false;
+            zs_.next_in = (Bytef*)in.data();
+            zs_.avail_in = in.size();
+            out.clear();
+            char buf[16384];
+            do {
+                zs_.next_out = (Bytef*)buf;
+                zs_.avail_out = sizeof(buf);
+                int rc = deflate(&zs_, Z_SYNC_FLUSH);
+                if (rc != Z_OK && rc != Z_BUF_ERROR) return false;
+                out.append(buf, sizeof(buf) - zs_.avail_out);
+            } while (zs_.avail_out == 0);
+            // RFC 7692: drop the 00 00 FF FF tail of the sync flush
+            if (out.size() >= 4 && out.compare(out.size() - 4, 4, "\x00\x00\xff\xff", 4) == 0) {
+                out.resize(out.size() - 4);
+            }
+            if (resetAfter) deflateReset(&zs_);
+            return true;
+        }
+
+    private:
+        z_stream zs_{};
+        bool ok_ = false;
+    };
+
+    class Inflater {
+    public:
+        Inflater() { ok_ = inflateInit2(&zs_, -15) == Z_OK; }
+        ~Inflater() { if (ok_) inflateEnd(&zs_); }
+        Inflater(const Inflater&) = delete;
+        Inflater& operator=(const Inflater&) = delete;
+
+        bool decompress(const std::string& in, std::string& out, bool resetAfter) {
+            if (!ok_) return false;
+            std::string data = in + std::string("\x00\x00\xff\xff", 4);
+            zs_.next_in = (Bytef*)data.data();
+            zs_.avail_in = data.size();
+            out.clear();
+            char buf[16384];
+            do {
+                zs_.next_out = (Bytef*)buf;
+                zs_.avail_out = sizeof(buf);
+                int rc = inflate(&zs_, Z_SYNC_FLUSH);
+                if (rc == Z_BUF_ERROR) break; // No progress possible: input consumed
+                if (rc != Z_OK && rc != Z_STREAM_END) return false;
+                out.append(buf, sizeof(buf) - zs_.avail_out);
+                if (rc == Z_STREAM_END) break;
+            } while (zs_.avail_in > 0 || zs_.avail_out == 0);
+            if (resetAfter) inflateReset(&zs_);
+            return true;
+        }
+
+    private:
+        z_stream zs_{};
+        bool ok_ = false;
+    };
+#endif
+
+    using Frame = std::shared_ptr<const std::string>;
+
+    // A publication that passed a client's attribute filters, waiting for
+    // that client's writer thread to apply its regex
+    struct RegexCandidate {
+        std::shared_ptr<const Publication> pub;
+        std::shared_ptr<const Subscription> subscription;
+    };
+
+    struct Client {
+        int socket;
+
+        // Serializes framing, the deflate context and the outbox, so frames
+        // are queued in the order they were compressed.
+        std::mutex sendMutex;
+        std::condition_variable outboxCv;
+        std::deque<Frame> outbox; // Drained by the client's writer thread
+        size_t outboxBytes = 0;   // Queued plus in-flight bytes
+        bool closing = false;
+        std::thread writer;
+        std::deque<RegexCandidate> candidates; // Guarded by sendMutex
+        size_t candidateBytes = 0;
+
+        // Writer thread only: the unfinished line of each port and channel,
+        // so a regex also matches lines split across read batches
+        std::map<std::pair<std::string, int>, std::string> lineTails;
+
+        // Negotiated permessage-deflate parameters
+        bool deflate = false;
+        bool serverNoContextTakeover = false;
+        bool clientNoContextTakeover = false;
+        int serverMaxWindowBits = 15;
+
+        // Replaced, never modified, so the publisher can match against a
+        // snapshot outside clientsMutex_
+        std::shared_ptr<const Subscription> subscription = std::make_shared<const Subscription>(); // Guarded by clientsMutex_
+#ifdef HW_ANALYZER_HAVE_ZLIB
+        std::unique_ptr<Deflater> tx;
+        std::unique_ptr<Inflater> rx;
+#endif
+
+        explicit Client(int s) : socket(s) {}
+    };
+
+    // Per-publication cache of finished frames
+    struct FrameCache {
+        Frame plain;
+        std::map<int, Frame> stateless; // Keyed by server window bits
+    };
+
+    static std::string buildFrame(const std::string& payload, bool compressed) {
+        std::string frame;
+        frame.push_back((char)(compressed ? 0xC1 : 0x81)); // FIN + text frame (+ RSV1)
+
+        if (payload.size() < 126) {
+            frame.push_back((char)payload.size());
+        } else if (payload.size() < 65536) {
+            frame.push_back((char)126);
+            frame.push_back((char)((payload.size() >> 8) & 0xFF));
+            frame.push_back((char)(payload.size() & 0xFF));
+        } else {
+            frame.push_back((char)127);
+            for (int i = 7; i >= 0; i--) {
+                frame.push_back((char)((payload.size() >> (i * 8)) & 0xFF));
+            }
+        }
+
+        frame += payload;
+        return frame;
+    }
+
+    static std::string headerValue(const std::string& request, const std::string& name) {
+        std::string lowerRequest = request;
+        std::string lowerName = name + ":";
+        std::transform(lowerRequest.begin(), lowerRequest.end(), lowerRequest.begin(), ::tolower);
+        std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), ::tolower);
+
+        size_t pos = lowerRequest.find("\r\n" + lowerName);
+        if (pos == std::string::npos) return "";
+        pos += 2 + lowerName.size();
+        size_t end = request.find("\r\n", pos);
+        std::string value = request.substr(pos, end - pos);
+        value.erase(0, value.find_first_not_of(" \t"));
+        return value;
+    }
+
+    static std::string trim(const std::string& s) {
+        size_t begin = s.find_first_not_of(" \t");
+        if (begin == std::string::npos) return "";
+        return s.substr(begin, s.find_last_not_of(" \t") - begin + 1);
+    }
+
+    bool wantsCompression(const std::string& request) const {
+        switch (compression_.mode) {
+            case CompressionOptions::Mode::Always:
+                return true;
+            case CompressionOptions::Mode::Requested: {
+                std::string uri = request.substr(0, request.find("\r\n"));
+                return uri.find("?compress") != std::string::npos ||
+                       uri.find("&compress") != std::string::npos;
+            }
+            default:
+                return false;
+        }
+    }
+
+    // Pick the first acceptable permessage-deflate offer. Returns the
+    // Sec-WebSocket-Extensions response value, or "" to decline.
+    std::string negotiateDeflate(const std::string& offers, Client& client) {
+#ifdef HW_ANALYZER_HAVE_ZLIB
+        std::stringstream offerStream(offers);
+        std::string offer;
+        while (std::getline(offerStream, offer, ',')) {
+            std::stringstream paramStream(offer);
+            std::string param;
+            std::getline(paramStream, param, ';');
+            if (trim(param) != "permessage-deflate") continue;
+
+            bool acceptable = true;
+            bool serverNoContext = !compression_.contextTakeover;
+            bool clientNoContext = false;
+            int serverBits = 15;
+            bool serverBitsRequested = false;
+            while (std::getline(paramStream, param, ';')) {
+                param = trim(param);
+                std::string key = param.substr(0, param.find('='));
+                std::string value = param.find('=') == std::string::npos
+                    ? "" : trim(param.substr(param.find('=') + 1));
+                if (!value.empty() && value.front() == '"') value = value.substr(1, value.size() - 2);
+
+                if (key == "server_no_context_takeover") {
+                    serverNoContext = true;
+                } else if (key == "client_no_context_takeover") {
+                    clientNoContext = true;
+                } else if (key == "server_max_window_bits") {
+                    serverBits = value.empty() ? 0 : std::atoi(value.c_str());
+                    serverBitsRequested = true;
+                    // zlib cannot produce an 8-bit raw deflate window
+                    if (serverBits < 9 || serverBits > 15) acceptable = false;
+                } else if (key == "client_max_window_bits") {
+                    // Our inflater always uses the full window, so any value works
+                } else {
+                    acceptable = false;
+                }
+            }
+            if (!acceptable) continue;
+
+            client.deflate = true;
+            client.serverNoContextTakeover = serverNoContext;
+            client.clientNoContextTakeover = clientNoContext;
+            client.serverMaxWindowBits = serverBits;
+            if (!serverNoContext) {
+                client.tx = std::make_unique<Deflater>(compression_.level, serverBits);
+            }
+            client.rx = std::make_unique<Inflater>();
+
+            std::string response = "permessage-deflate";
+            if (serverNoContext) response += "; server_no_context_takeover";
+            if (clientNoContext) response += "; client_no_context_takeover";
+            if (serverBitsRequested) response += "; server_max_window_bits=" + std::to_string(serverBits);
+            return response;
+        }
+#else
+        (void)offers;
+        (void)client;
+#endif
+        return "";
+    }
+
     void handleClient(int clientSocket) {
         // Read HTTP upgrade request
         char buffer[4096];
@@ -237,8 +716,8 @@ private:
         std::string request(buffer);
 
         // Extract WebSocket key
-        size_t keyPos = request.find("Sec-WebSocket-Key: ");
-        if (keyPos == std::string::npos) {
+        std::string key = headerValue(request, "Sec-WebSocket-Key");
+        if (key.empty()) {
 #ifdef _WIN32
             closesocket(clientSocket);
 #else
@@ -247,19 +726,27 @@ private:
             return;
         }
 
-        keyPos += 19;
-        size_t keyEnd = request.find("\r\n", keyPos);
-        std::string key = request.substr(keyPos, keyEnd - keyPos);
+        auto client = std::make_shared<Client>(clientSocket);
 
         // Compute proper WebSocket accept key
         std::string acceptKey = computeAcceptKey(key);
 
+        std::string extensions;
+        if (wantsCompression(request)) {
+            extensions = negotiateDeflate(headerValue(request, "Sec-WebSocket-Extensions"), *client);
+        }
+
         // Send WebSocket accept response
         std::string response =
             "HTTP/1.1 101 Switching Protocols\r\n"
             "Upgrade: websocket\r\n"
             "Connection: Upgrade\r\n"
-            "Sec-WebSocket-Accept: " + acceptKey + "\r\n\r\n";
+            "Sec-WebSocket-Accept: " + acceptKey + "\r\n";
+        if (!extensions.empty()) {
+            response += "Sec-WebSocket-Extensions: " + extensions + "\r\n";
+            std::cout << "[WS] Negotiated " << extensions << std::endl;
+        }
+        response += "\r\n";
 
         int sent = send(clientSocket, response.c_str(), response.length(), 0);
         
@@ -267,10 +754,16 @@ private:
             std::cerr << "[WS] Error: Failed to send complete handshake response" << std::endl;
         }
 
+        // Frames go out on their own thread so a slow reader only fills its
+        // own outbox
+        client->writer = std::thread([this, client]() {
+            writeLoop(*client);
+        });
+
         // Add to clients list
         {
             std::lock_guard<std::mutex> lock(clientsMutex_);
-            clients_.push_back(clientSocket);
+            clients_.push_back(client);
         }
 
         // Read WebSocket frames
@@ -282,6 +775,7 @@ private:
             if (bytesRead >= 2) {
                 uint8_t* frame = (uint8_t*)buffer;
                 bool fin = (frame[0] & 0x80) != 0;
+                bool compressed = (frame[0] & 0x40) != 0; // RSV1: permessage-deflate
                 uint8_t opcode = frame[0] & 0x0F;
                 bool masked = (frame[1] & 0x80) != 0;
                 uint64_t payloadLen = frame[1] & 0x7F;
@@ -304,10 +798,24 @@ private:
                         for (size_t i = 0; i < payloadLen; i++) {
                             payload += (char)(data[i] ^ mask[i % 4]);
                         }
+
+                        if (compressed) {
+#ifdef HW_ANALYZER_HAVE_ZLIB
+                            std::string inflated;
+                            if (!client->deflate ||
+                                !client->rx->decompress(payload, inflated, client->clientNoContextTakeover)) {
+                                std::cerr << "[WS] Error: Failed to inflate frame" << std::endl;
+                                continue;
+                            }
+                            payload.swap(inflated);
+#else
+                            continue;
+#endif
+                        }
                         
                         if (messageHandler_) {
-                            std::string response = messageHandler_(payload);
-                            sendWebSocketFrame(clientSocket, response);
+                            std::string response = messageHandler_(clientSocket, payload);
+                            sendMessage(*client, response, nullptr, false);
                         }
                     }
                 }
@@ -317,7 +825,20 @@ private:
         // Remove from clients list
         {
             std::lock_guard<std::mutex> lock(clientsMutex_);
-            clients_.erase(std::remove(clients_.begin(), clients_.end(), clientSocket), clients_.end());
+            clients_.erase(std::remove(clients_.begin(), clients_.end(), client), clients_.end());
+        }
+
+        // Unblock a writer stuck in send() and wait for it
+        {
+            std::lock_guard<std::mutex> lock(client->sendMutex);
+            client->closing = true;
+        }
+        client->outboxCv.notify_one();
+        shutdownSocket(clientSocket);
+        client->writer.join();
+
+        if (disconnectHandler_) {
+            disconnectHandler_(clientSocket);
         }
 
 #ifdef _WIN32
@@ -328,32 +849,240 @@ private:
         std::cout << "Client disconnected" << std::endl;
     }
 
-    void sendWebSocketFrame(int clientSocket, const std::string& message) {
-        std::vector<uint8_t> frame;
-        frame.push_back(0x81); // FIN + text frame
-        
-        if (message.size() < 126) {
-            frame.push_back(message.size());
-        } else if (message.size() < 65536) {
-            frame.push_back(126);
-            frame.push_back((message.size() >> 8) & 0xFF);
-            frame.push_back(message.size() & 0xFF);
-        } else {
-            frame.push_back(127);
-            for (int i = 7; i >= 0; i--) {
-                frame.push_back((message.size() >> (i * 8)) & 0xFF);
+    // Frame the message and queue it for the client's writer thread.
+    // Publications (bounded) are dropped while the outbox is full; the check
+    // comes before compression so a dropped message never advances the
+    // deflate context. Command responses are always queued.
+    bool sendMessage(Client& client, const std::string& message, FrameCache* cache, bool bounded) {
+        std::lock_guard<std::mutex> lock(client.sendMutex);
+        if (client.closing) return false;
+        if (bounded && client.outboxBytes + message.size() > kMaxOutboxBytes) {
+            droppedFrames_++;
+            return false;
+        }
+
+        Frame frame = frameFor(client, message, cache);
+        client.outboxBytes += frame->size();
+        client.outbox.push_back(std::move(frame));
+        client.outboxCv.notify_one();
+        return true;
+    }
+
+    // Called with client.sendMutex held
+    Frame frameFor(Client& client, const std::string& message, FrameCache* cache) {
+#ifdef HW_ANALYZER_HAVE_ZLIB
+        if (client.deflate && message.size() >= compression_.minFrameSize) {
+            std::string payload;
+            if (client.serverNoContextTakeover) {
+                // Output depends only on the message and window size: share it
+                if (cache) {
+                    auto it = cache->stateless.find(client.serverMaxWindowBits);
+                    if (it != cache->stateless.end()) {
+                        return it->second;
+                    }
+                }
+                if (compressStateless(message, client.serverMaxWindowBits, payload)) {
+                    auto frame = std::make_shared<const std::string>(buildFrame(payload, true));
+                    if (cache) cache->stateless[client.serverMaxWindowBits] = frame;
+                    return frame;
+                }
+            } else if (client.tx->compress(message, payload, false)) {
+                return std::make_shared<const std::string>(buildFrame(payload, true));
             }
         }
-        
-        frame.insert(frame.end(), message.begin(), message.end());
-        send(clientSocket, (char*)frame.data(), frame.size(), 0);
+#endif
+
+        if (!cache) {
+            return std::make_shared<const std::string>(buildFrame(message, false));
+        }
+        if (!cache->plain) {
+            cache->plain = std::make_shared<const std::string>(buildFrame(message, false));
+        }
+        return cache->plain;
+    }
+
+    // Queue a publication for the client's regex, which runs on the
+    // client's writer thread so an expensive pattern only delays that client
+    void queueCandidate(Client& client, const std::shared_ptr<const Publication>& pub,
+                        const std::shared_ptr<const Subscription>& subscription) {
+        std::lock_guard<std::mutex> lock(client.sendMutex);
+        if (client.closing) return;
+        size_t size = pub->data.size() + pub->json.size();
+        if (client.candidateBytes + size > kMaxOutboxBytes) {
+            droppedFrames_++;
+            return;
+        }
+        client.candidates.push_back({pub, subscription});
+        client.candidateBytes += size;
+        client.outboxCv.notify_one();
+    }
+
+    // Writer thread: the regex is searched in the current line, i.e. the
+    // payload prefixed with the unfinished line from earlier batches of the
+    // same port and channel. Only a match that reaches into this payload
+    // delivers it.
+    void filterCandidates(Client& client, std::deque<RegexCandidate>& candidates) {
+        for (const auto& candidate : candidates) {
+            const Publication& pub = *candidate.pub;
+            std::string& tail = client.lineTails[{pub.port, pub.channel}];
+            std::string text = tail + pub.data;
+            bool match = candidate.subscription->matchesText(text, tail.size());
+
+            size_t lineStart = text.find_last_of('\n');
+            lineStart = lineStart == std::string::npos ? 0 : lineStart + 1;
+            if (text.size() - lineStart > kMaxLineTail) lineStart = text.size() - kMaxLineTail;
+            tail = text.substr(lineStart);
+
+            if (match) sendMessage(client, pub.json, nullptr, true);
+        }
+        candidates.clear();
+    }
+
+    void writeLoop(Client& client) {
+        std::deque<Frame> frames;
+        std::deque<RegexCandidate> candidates;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(client.sendMutex);
+                client.outboxCv.wait(lock, [&client] {
+                    return client.closing || !client.outbox.empty() || !client.candidates.empty();
+                });
+                if (client.closing) break;
+                candidates.swap(client.candidates);
+                client.candidateBytes = 0;
+            }
+            // Matches are framed into the outbox under sendMutex, behind
+            // anything already queued, so frames keep their order
+            filterCandidates(client, candidates);
+            {
+                std::lock_guard<std::mutex> lock(client.sendMutex);
+                if (client.closing) break;
+                frames.swap(client.outbox);
+            }
+
+            size_t sentBytes = 0;
+            bool ok = true;
+            for (const auto& frame : frames) {
+                if (!sendAll(client.socket, *frame)) {
+                    ok = false;
+                    break;
+                }
+                sentBytes += frame->size();
+            }
+            frames.clear();
+
+            std::lock_guard<std::mutex> lock(client.sendMutex);
+            client.outboxBytes -= sentBytes;
+            if (!ok) {
+                // Peer is gone: stop queuing and let the reader notice
+                client.closing = true;
+                client.outbox.clear();
+                client.outboxBytes = 0;
+                shutdownSocket(client.socket);
+                break;
+            }
+        }
+    }
+
+    static void shutdownSocket(int clientSocket) {
+#ifdef _WIN32
+        shutdown(clientSocket, SD_BOTH);
+#else
+        shutdown(clientSocket, SHUT_RDWR);
+#endif
+    }
+
+#ifdef HW_ANALYZER_HAVE_ZLIB
+    bool compressStateless(const std::string& message, int windowBits, std::string& out) {
+        std::lock_guard<std::mutex> lock(statelessMutex_);
+        auto& deflater = statelessDeflaters_[windowBits];
+        if (!deflater) deflater = std::make_unique<Deflater>(compression_.level, windowBits);
+        return deflater->compress(message, out, true);
+    }
+#endif
+
+    void publishLoop() {
+        std::vector<std::shared_ptr<const Publication>> batch;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(publishMutex_);
+                publishCv_.wait(lock, [this] { return !running_ || !publishQueue_.empty(); });
+                if (publishQueue_.empty()) break;
+                batch.swap(publishQueue_);
+            }
+            deliver(batch);
+            batch.clear();
+        }
+    }
+
+    // Evaluate each distinct set of attribute filters once for the whole
+    // batch, then queue only the matching messages. Clients with a regex get
+    // the matches as candidates for their own writer thread. Clients are
+    // snapshotted so that framing happens outside clientsMutex_.
+    void deliver(const std::vector<std::shared_ptr<const Publication>>& batch) {
+        std::vector<std::pair<std::shared_ptr<Client>, std::shared_ptr<const Subscription>>> targets;
+        {
+            std::lock_guard<std::mutex> lock(clientsMutex_);
+            targets.reserve(clients_.size());
+            for (auto& client : clients_) {
+                targets.emplace_back(client, client->subscription);
+            }
+        }
+
+        std::vector<FrameCache> caches(batch.size());
+        std::map<std::string, std::vector<size_t>> matchesByFilter;
+        for (auto& target : targets) {
+            const Subscription& sub = *target.second;
+            auto it = matchesByFilter.find(sub.key());
+            if (it == matchesByFilter.end()) {
+                std::vector<size_t> matches;
+                for (size_t i = 0; i < batch.size(); i++) {
+                    if (sub.matchesAttributes(*batch[i])) matches.push_back(i);
+                }
+                it = matchesByFilter.emplace(sub.key(), std::move(matches)).first;
+            }
+            for (size_t i : it->second) {
+                if (sub.hasRegex()) {
+                    queueCandidate(*target.first, batch[i], target.second);
+                } else {
+                    sendMessage(*target.first, batch[i]->json, &caches[i], true);
+                }
+            }
+        }
+    }
+
+    bool sendAll(int clientSocket, const std::string& frame) {
+        size_t offset = 0;
+        while (offset < frame.size()) {
+            int n = send(clientSocket, frame.data() + offset, frame.size() - offset, 0);
+            if (n <= 0) return false;
+            offset += n;
+        }
+        return true;
     }
 
     int port_;
     std::atomic<bool> running_{false};
     MessageHandler messageHandler_;
-    std::vector<int> clients_;
-    std::mutex clientsMutex_;
+    DisconnectHandler disconnectHandler_;
+    CompressionOptions compression_;
+    ThreadPlacement publisherPlacement_;
+    std::vector<std::shared_ptr<Client>> clients_;
+    mutable std::mutex clientsMutex_;
+
+    static constexpr size_t kMaxQueuedPublications = 65536;
+    static constexpr size_t kMaxOutboxBytes = 4 * 1024 * 1024; // Per client
+    static constexpr size_t kMaxLineTail = 1024; // Longest unfinished line kept for regex matching
+    std::thread publisher_;
+    std::vector<std::shared_ptr<const Publication>> publishQueue_;
+    std::mutex publishMutex_;
+    std::condition_variable publishCv_;
+    std::atomic<uint64_t> droppedPublications_{0};
+    std::atomic<uint64_t> droppedFrames_{0};
+#ifdef HW_ANALYZER_HAVE_ZLIB
+    std::map<int, std::unique_ptr<Deflater>> statelessDeflaters_;
+    std::mutex statelessMutex_;
+#endif
 };
 
 } // namespace hw_analyzer
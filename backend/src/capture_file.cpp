@@ -0,0 +1,849 @@
+#include "capture_file.hpp"
+#include <iostream>
+#include <cstring>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+#include <algorithm>
+#include <map>
+#include <cerrno>
+
+#ifdef HW_ANALYZER_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef HW_ANALYZER_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+namespace hw_analyzer {
+
+namespace {
+
+const char kFileMagic[8] = {'H', 'W', 'A', 'C', 'A', 'P', '\r', '\n'};
+const char kFooterMagic[8] = {'H', 'W', 'A', 'I', 'D', 'X', '\r', '\n'};
+const uint32_t kBlockMagic = 0x4B4C4248; // "HBLK"
+const uint32_t kVersion = 2;
+
+const size_t kFileHeaderSize = 16;
+const size_t kBlockHeaderSize = 36;
+const size_t kIndexEntrySize = 48;
+const size_t kFooterSize = 24;
+const size_t kGroupHeaderSize = 24;
+
+// Block buffers allocated and touched in open(): one is filled by the
+// capture path, the rest wait for or sit in the compression thread. When
+// none is free the capture path drops records rather than allocate or wait.
+const size_t kBlockPoolSize = 16;
+
+// Upper bound for a block, enforced by the writer and trusted by the reader
+// so a corrupt size field cannot force a huge allocation
+const size_t kMaxBlockSize = 64 * 1024 * 1024;
+const size_t kMinBlockSize = 64 * 1024;
+
+// Consecutive batches of one channel are stored as a group: one header,
+// then small per-batch entries, then the batches' bytes back to back. A
+// serial reader often wakes for a handful of bytes, so a header per batch
+// would outweigh the data. Groups are staged per channel and copied into
+// the block when full, when the line settings change, after a second, or
+// on flush. Channels from kStagedChannels on are stored one batch per group.
+const size_t kStagedChannels = 16;
+const size_t kGroupDataLimit = 16 * 1024;
+const size_t kGroupMaxBatches = 512;
+const size_t kMaxEntrySize = 30; // Three varints
+const uint64_t kGroupMaxSpanNs = 1000000000ULL;
+const int kZstdLevel = 9;
+
+void put16(std::string& out, uint16_t v) {
+    for (int i = 0; i < 2; i++) out.push_back(static_cast<char>((v >> (i * 8)) & 0xFF));
+}
+
+void put32(std::string& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back(static_cast<char>((v >> (i * 8)) & 0xFF));
+}
+
+void put64(std::string& out, uint64_t v) {
+    for (int i = 0; i < 8; i++) out.push_back(static_cast<char>((v >> (i * 8)) & 0xFF));
+}
+
+void putVarint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+bool getVarint(const char*& p, const char* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*p++);
+        v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+uint64_t getLE(const char* p, int bytes) {
+    uint64_t v = 0;
+    for (int i = bytes - 1; i >= 0; i--) v = (v << 8) | static_cast<uint8_t>(p[i]);
+    return v;
+}
+
+bool seekTo(std::FILE* f, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(f, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+    return fseeko(f, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+uint64_t fileSize(std::FILE* f) {
+#ifdef _WIN32
+    _fseeki64(f, 0, SEEK_END);
+    return static_cast<uint64_t>(_ftelli64(f));
+#else
+    fseeko(f, 0, SEEK_END);
+    return static_cast<uint64_t>(ftello(f));
+#endif
+}
+
+bool readExact(std::FILE* f, char* buf, size_t n) {
+    return std::fread(buf, 1, n, f) == n;
+}
+
+bool writeExact(std::FILE* f, const std::string& data) {
+    return std::fwrite(data.data(), 1, data.size(), f) == data.size();
+}
+
+// Returns the codec actually used; falls back to None when compression
+// is unavailable or does not shrink the block.
+CaptureCodec compressBlock(CaptureCodec codec, const std::string& raw, std::string& out) {
+    switch (codec) {
+#ifdef HW_ANALYZER_HAVE_LZ4
+        case CaptureCodec::LZ4: {
+            out.resize(LZ4_compressBound(static_cast<int>(raw.size())));
+            int n = LZ4_compress_default(raw.data(), &out[0],
+                                         static_cast<int>(raw.size()),
+                                         static_cast<int>(out.size()));
+            if (n > 0 && static_cast<size_t>(n) < raw.size()) {
+                out.resize(n);
+                return CaptureCodec::LZ4;
+            }
+            break;
+        }
+#endif
+#ifdef HW_ANALYZER_HAVE_ZSTD
+        case CaptureCodec::Zstd: {
+            out.resize(ZSTD_compressBound(raw.size()));
+            size_t n = ZSTD_compress(&out[0], out.size(), raw.data(), raw.size(), kZstdLevel);
+            if (!ZSTD_isError(n) && n < raw.size()) {
+                out.resize(n);
+                return CaptureCodec::Zstd;
+            }
+            break;
+        }
+#endif
+        default:
+            break;
+    }
+    out = raw;
+    return CaptureCodec::None;
+}
+
+bool decompressBlock(CaptureCodec codec, const std::string& in, uint32_t rawSize, std::string& out) {
+    out.resize(rawSize);
+    switch (codec) {
+        case CaptureCodec::None:
+            if (in.size() != rawSize) return false;
+            out = in;
+            return true;
+#ifdef HW_ANALYZER_HAVE_LZ4
+        case CaptureCodec::LZ4: {
+            int n = LZ4_decompress_safe(in.data(), &out[0], static_cast<int>(in.size()),
+                                        static_cast<int>(rawSize));
+            return n == static_cast<int>(rawSize);
+        }
+#endif
+#ifdef HW_ANALYZER_HAVE_ZSTD
+        case CaptureCodec::Zstd: {
+            size_t n = ZSTD_decompress(&out[0], rawSize, in.data(), in.size());
+            return !ZSTD_isError(n) && n == rawSize;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+bool parseBlockHeader(const char* p, CaptureBlockInfo& info) {
+    if (getLE(p, 4) != kBlockMagic) return false;
+    info.codec = static_cast<CaptureCodec>(static_cast<uint8_t>(p[4]));
+    info.rawSize = static_cast<uint32_t>(getLE(p + 8, 4));
+    info.compressedSize = static_cast<uint32_t>(getLE(p + 12, 4));
+    info.recordCount = static_cast<uint32_t>(getLE(p + 16, 4));
+    info.firstNs = getLE(p + 20, 8);
+    info.lastNs = getLE(p + 28, 8);
+    // Stored blocks are never larger than the raw data, compressed ones
+    // only slightly
+    return info.rawSize <= kMaxBlockSize && info.compressedSize <= kMaxBlockSize + kMaxBlockSize / 64;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// CaptureWriter
+
+class CaptureWriter::Impl {
+public:
+    struct Pending {
+        std::string raw;
+        uint32_t recordCount = 0;
+        uint64_t firstNs = 0;
+        uint64_t lastNs = 0;
+    };
+
+    // Batches of one channel waiting to be copied into the current block
+    struct Group {
+        std::string entries; // Per batch: wakeup delta, wakeup - firstByte, length
+        std::string data;
+        uint32_t count = 0;
+        uint32_t byteTimeNs = 0;
+        uint64_t firstNs = 0;
+        uint64_t lastNs = 0;
+
+        bool accepts(const std::string& batch, const RxTimestamp& ts) const {
+            return count < kGroupMaxBatches && data.size() + batch.size() <= kGroupDataLimit &&
+                   ts.byteTimeNs == byteTimeNs && ts.wakeupNs >= lastNs &&
+                   ts.wakeupNs - firstNs <= kGroupMaxSpanNs;
+        }
+
+        void addEntry(size_t length, const RxTimestamp& ts) {
+            if (count == 0) {
+                firstNs = lastNs = ts.wakeupNs;
+                byteTimeNs = ts.byteTimeNs;
+            }
+            putVarint(entries, ts.wakeupNs - lastNs);
+            putVarint(entries, ts.firstByteNs < ts.wakeupNs ? ts.wakeupNs - ts.firstByteNs : 0);
+            putVarint(entries, length);
+            lastNs = ts.wakeupNs;
+            count++;
+        }
+
+        void add(const std::string& batch, const RxTimestamp& ts) {
+            addEntry(batch.size(), ts);
+            data.append(batch);
+        }
+
+        void clear() {
+            entries.clear();
+            data.clear();
+            count = 0;
+        }
+    };
+
+    std::FILE* file = nullptr;
+    bool ownsFile = false;
+    CaptureCodec codec = CaptureCodec::LZ4;
+    size_t blockSize = 256 * 1024;
+    ThreadPlacement placement;
+
+    // Shared between the capture path and the compression thread
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    Pending current;
+    std::deque<Pending> queue;
+    std::vector<std::string> spare; // Free buffers from the pool
+    std::vector<Group> groups;      // Staged batches, indexed by channel
+    Group single;                   // Entry of a batch that is not staged
+    bool stopping = false;
+    Stats stats;
+
+    // Compression thread only
+    std::thread worker;
+    uint64_t offset = 0;
+    uint64_t nextRecord = 0;
+    std::vector<CaptureBlockInfo> index;
+
+    // Caller holds mutex. Copies a group into the current block, sealing the
+    // block first if it would overflow. The group is dropped if no free
+    // buffer is left.
+    void commit(Group& group, uint16_t channel) {
+        if (group.count > 0) place(group, group.data, channel);
+        group.clear();
+    }
+
+    void place(const Group& group, const std::string& data, uint16_t channel) {
+        size_t size = kGroupHeaderSize + group.entries.size() + data.size();
+        if (current.raw.size() + size > blockSize && !seal(false)) {
+            stats.droppedRecords += group.count;
+            return;
+        }
+
+        auto& cur = current;
+        put64(cur.raw, group.firstNs);
+        put32(cur.raw, group.byteTimeNs);
+        put16(cur.raw, channel);
+        put16(cur.raw, static_cast<uint16_t>(group.count));
+        put32(cur.raw, static_cast<uint32_t>(group.entries.size()));
+        put32(cur.raw, static_cast<uint32_t>(data.size()));
+        cur.raw.append(group.entries);
+        cur.raw.append(data);
+
+        if (cur.recordCount == 0 || group.firstNs < cur.firstNs) cur.firstNs = group.firstNs;
+        if (group.lastNs > cur.lastNs) cur.lastNs = group.lastNs;
+        cur.recordCount += group.count;
+
+        stats.records += group.count;
+        stats.rawBytes += size;
+    }
+
+    // Caller holds mutex. Stores one batch as a group of its own.
+    void placeSingle(const std::string& data, const RxTimestamp& ts, uint16_t channel) {
+        single.clear();
+        single.addEntry(data.size(), ts);
+        place(single, data, channel);
+        single.clear();
+    }
+
+    // Caller holds mutex
+    void commitAll() {
+        for (size_t i = 0; i < groups.size(); i++) {
+            commit(groups[i], static_cast<uint16_t>(i));
+        }
+    }
+
+    // Caller holds mutex. Returns false if no free buffer is left; the
+    // capture path never allocates.
+    bool seal(bool force) {
+        if (current.recordCount == 0) return true;
+        if (!force && spare.empty()) return false;
+        queue.push_back(std::move(current));
+        current = Pending();
+        if (!spare.empty()) {
+            current.raw = std::move(spare.back());
+            spare.pop_back();
+        }
+        stats.blocks++;
+        cv.notify_one();
+        return true;
+    }
+
+    // Returns false if the file could not be written
+    bool writeBlock(const Pending& block) {
+        std::string payload;
+        CaptureCodec used = compressBlock(codec, block.raw, payload);
+
+        std::string header;
+        put32(header, kBlockMagic);
+        header.push_back(static_cast<char>(used));
+        header.append(3, '\0');
+        put32(header, static_cast<uint32_t>(block.raw.size()));
+        put32(header, static_cast<uint32_t>(payload.size()));
+        put32(header, block.recordCount);
+        put64(header, block.firstNs);
+        put64(header, block.lastNs);
+
+        if (!writeExact(file, header) || !writeExact(file, payload)) {
+            return false;
+        }
+
+        CaptureBlockInfo info;
+        info.offset = offset;
+        info.rawSize = static_cast<uint32_t>(block.raw.size());
+        info.compressedSize = static_cast<uint32_t>(payload.size());
+        info.recordCount = block.recordCount;
+        info.codec = used;
+        info.firstNs = block.firstNs;
+        info.lastNs = block.lastNs;
+        info.firstRecord = nextRecord;
+        index.push_back(info);
+
+        offset += header.size() + payload.size();
+        nextRecord += block.recordCount;
+        return true;
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            cv.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) break;
+
+            Pending block = std::move(queue.front());
+            queue.pop_front();
+            bool failed = stats.writeError;
+            lock.unlock();
+
+            // After a failed write (e.g. disk full) later blocks are dropped:
+            // a partial block in the middle would hide everything after it
+            bool ok = !failed && writeBlock(block);
+
+            lock.lock();
+            stats.writtenBytes = offset;
+            if (!ok) {
+                if (!failed) {
+                    stats.writeError = true;
+                    std::cerr << "[Capture] Write failed: " << std::strerror(errno) << std::endl;
+                }
+                stats.droppedRecords += block.recordCount;
+            }
+            block.raw.clear();
+            spare.push_back(std::move(block.raw));
+        }
+    }
+
+    // Returns false if the file could not be written
+    bool writeIndex() {
+        std::string out;
+        for (const auto& b : index) {
+            put64(out, b.offset);
+            put32(out, b.rawSize);
+            put32(out, b.compressedSize);
+            put32(out, b.recordCount);
+            out.push_back(static_cast<char>(b.codec));
+            out.append(3, '\0');
+            put64(out, b.firstNs);
+            put64(out, b.lastNs);
+            put64(out, b.firstRecord);
+        }
+        put64(out, offset);
+        put64(out, index.size());
+        out.append(kFooterMagic, sizeof(kFooterMagic));
+        if (!writeExact(file, out)) return false;
+        offset += out.size();
+        return true;
+    }
+};
+
+CaptureWriter::CaptureWriter() : pImpl(std::make_unique<Impl>()) {}
+
+CaptureWriter::~CaptureWriter() {
+    close();
+}
+
+void CaptureWriter::setThreadPlacement(const ThreadPlacement& placement) {
+    pImpl->placement = placement;
+}
+
+bool CaptureWriter::codecAvailable(CaptureCodec codec) {
+    switch (codec) {
+        case CaptureCodec::None: return true;
+#ifdef HW_ANALYZER_HAVE_LZ4
+        case CaptureCodec::LZ4: return true;
+#endif
+#ifdef HW_ANALYZER_HAVE_ZSTD
+        case CaptureCodec::Zstd: return true;
+#endif
+        default: return false;
+    }
+}
+
+bool CaptureWriter::parseCodec(const std::string& name, CaptureCodec& codec) {
+    if (name == "none") codec = CaptureCodec::None;
+    else if (name == "lz4") codec = CaptureCodec::LZ4;
+    else if (name == "zstd") codec = CaptureCodec::Zstd;
+    else return false;
+    return true;
+}
+
+bool CaptureWriter::open(const std::string& path, CaptureCodec codec, size_t blockSize) {
+    close();
+
+    if (!codecAvailable(codec)) {
+        std::cerr << "[Capture] Codec not compiled in" << std::endl;
+        return false;
+    }
+
+    std::FILE* f = nullptr;
+    bool owns = true;
+    if (path == "-") {
+        f = stdout;
+        owns = false;
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    } else {
+        f = std::fopen(path.c_str(), "wb");
+    }
+    if (!f) {
+        std::cerr << "[Capture] Failed to open " << path << std::endl;
+        return false;
+    }
+
+    std::string header(kFileMagic, sizeof(kFileMagic));
+    put32(header, kVersion);
+    put32(header, 0);
+    if (!writeExact(f, header)) {
+        std::cerr << "[Capture] Failed to write " << path << std::endl;
+        if (owns) std::fclose(f);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        pImpl->file = f;
+        pImpl->ownsFile = owns;
+        pImpl->codec = codec;
+        pImpl->blockSize = std::min(std::max(blockSize, kMinBlockSize), kMaxBlockSize);
+        pImpl->current = Impl::Pending();
+        pImpl->queue.clear();
+
+        // Allocate the pool up front and touch every page, so filling a
+        // block on the capture path neither allocates nor faults
+        pImpl->spare.resize(kBlockPoolSize);
+        for (auto& buffer : pImpl->spare) {
+            buffer.resize(pImpl->blockSize);
+            buffer.clear();
+        }
+        pImpl->current.raw = std::move(pImpl->spare.back());
+        pImpl->spare.pop_back();
+        pImpl->groups.resize(kStagedChannels);
+        for (auto& group : pImpl->groups) {
+            group.entries.resize(kGroupMaxBatches * kMaxEntrySize);
+            group.data.resize(kGroupDataLimit);
+            group.clear();
+        }
+        pImpl->single.entries.resize(kMaxEntrySize);
+        pImpl->single.clear();
+        pImpl->stopping = false;
+        pImpl->stats = Stats();
+        pImpl->offset = header.size();
+        pImpl->nextRecord = 0;
+        pImpl->index.clear();
+    }
+    pImpl->worker = std::thread([this]() {
+        applyThreadPlacement(pImpl->placement, "capture writer");
+        pImpl->run();
+    });
+    return true;
+}
+
+void CaptureWriter::close() {
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        if (!pImpl->file) return;
+        pImpl->commitAll();
+        pImpl->seal(true);
+        pImpl->stopping = true;
+    }
+    pImpl->cv.notify_one();
+    if (pImpl->worker.joinable()) {
+        pImpl->worker.join();
+    }
+
+    // Without the index the reader still recovers the blocks by scanning
+    bool ok = !pImpl->stats.writeError && pImpl->writeIndex();
+
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    if (pImpl->ownsFile) {
+        ok = std::fclose(pImpl->file) == 0 && ok;
+    } else {
+        ok = std::fflush(pImpl->file) == 0 && ok;
+    }
+    pImpl->file = nullptr;
+    pImpl->stats.writtenBytes = pImpl->offset;
+    if (!ok && !pImpl->stats.writeError) {
+        pImpl->stats.writeError = true;
+        std::cerr << "[Capture] Failed to finish the capture file: " << std::strerror(errno) << std::endl;
+    }
+}
+
+bool CaptureWriter::isOpen() const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    return pImpl->file != nullptr && !pImpl->stopping;
+}
+
+void CaptureWriter::append(const std::string& data, const RxTimestamp& ts, uint16_t channel) {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    if (!pImpl->file || pImpl->stopping) return;
+
+    if (kGroupHeaderSize + kMaxEntrySize + data.size() > pImpl->blockSize) {
+        pImpl->stats.droppedRecords++;
+        return;
+    }
+
+    if (channel < pImpl->groups.size()) {
+        auto& group = pImpl->groups[channel];
+        if (group.count > 0 && !group.accepts(data, ts)) {
+            pImpl->commit(group, channel);
+        }
+        if (data.size() > kGroupDataLimit) {
+            // Larger than a staging buffer: goes straight into the block
+            pImpl->placeSingle(data, ts, channel);
+        } else {
+            group.add(data, ts);
+        }
+        return;
+    }
+    pImpl->placeSingle(data, ts, channel);
+}
+
+void CaptureWriter::flush() {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    if (!pImpl->file) return;
+    pImpl->commitAll();
+    pImpl->seal(false);
+}
+
+CaptureWriter::Stats CaptureWriter::stats() const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    return pImpl->stats;
+}
+
+// ---------------------------------------------------------------------------
+// CaptureReader
+
+CaptureReader::~CaptureReader() {
+    close();
+}
+
+bool CaptureReader::open(const std::string& path) {
+    close();
+
+    file_ = std::fopen(path.c_str(), "rb");
+    if (!file_) return false;
+
+    char header[kFileHeaderSize];
+    if (!readExact(file_, header, sizeof(header)) ||
+        std::memcmp(header, kFileMagic, sizeof(kFileMagic)) != 0 ||
+        getLE(header + 8, 4) != kVersion) {
+        close();
+        return false;
+    }
+
+    if (!readIndex() && !scanBlocks()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void CaptureReader::close() {
+    if (file_) {
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+    blocks_.clear();
+}
+
+bool CaptureReader::readIndex() {
+    uint64_t size = fileSize(file_);
+    if (size < kFileHeaderSize + kFooterSize) return false;
+
+    char footer[kFooterSize];
+    if (!seekTo(file_, size - kFooterSize) || !readExact(file_, footer, sizeof(footer)) ||
+        std::memcmp(footer + 16, kFooterMagic, sizeof(kFooterMagic)) != 0) {
+        return false;
+    }
+
+    uint64_t indexOffset = getLE(footer, 8);
+    uint64_t count = getLE(footer + 8, 8);
+    if (count > size / kIndexEntrySize || indexOffset > size ||
+        indexOffset + count * kIndexEntrySize + kFooterSize != size) {
+        return false;
+    }
+
+    std::string entries(count * kIndexEntrySize, '\0');
+    if (!seekTo(file_, indexOffset) || !readExact(file_, &entries[0], entries.size())) {
+        return false;
+    }
+
+    blocks_.clear();
+    for (uint64_t i = 0; i < count; i++) {
+        const char* p = entries.data() + i * kIndexEntrySize;
+        CaptureBlockInfo info;
+        info.offset = getLE(p, 8);
+        info.rawSize = static_cast<uint32_t>(getLE(p + 8, 4));
+        info.compressedSize = static_cast<uint32_t>(getLE(p + 12, 4));
+        info.recordCount = static_cast<uint32_t>(getLE(p + 16, 4));
+        info.codec = static_cast<CaptureCodec>(static_cast<uint8_t>(p[20]));
+        info.firstNs = getLE(p + 24, 8);
+        info.lastNs = getLE(p + 32, 8);
+        info.firstRecord = getLE(p + 40, 8);
+        blocks_.push_back(info);
+    }
+    return true;
+}
+
+// Recover the index of a capture that was not closed cleanly
+bool CaptureReader::scanBlocks() {
+    uint64_t size = fileSize(file_);
+    uint64_t offset = kFileHeaderSize;
+    uint64_t record = 0;
+
+    blocks_.clear();
+    while (offset + kBlockHeaderSize <= size) {
+        char header[kBlockHeaderSize];
+        CaptureBlockInfo info;
+        if (!seekTo(file_, offset) || !readExact(file_, header, sizeof(header)) ||
+            !parseBlockHeader(header, info)) {
+            break;
+        }
+        if (offset + kBlockHeaderSize + info.compressedSize > size) break; // Truncated
+
+        info.offset = offset;
+        info.firstRecord = record;
+        blocks_.push_back(info);
+
+        offset += kBlockHeaderSize + info.compressedSize;
+        record += info.recordCount;
+    }
+    return true;
+}
+
+bool CaptureReader::readBlock(size_t index, std::vector<CaptureRecord>& out) {
+    out.clear();
+    if (!file_ || index >= blocks_.size()) return false;
+
+    const auto& expected = blocks_[index];
+    char header[kBlockHeaderSize];
+    CaptureBlockInfo info;
+    if (!seekTo(file_, expected.offset) || !readExact(file_, header, sizeof(header)) ||
+        !parseBlockHeader(header, info)) {
+        return false;
+    }
+
+    std::string payload(info.compressedSize, '\0');
+    std::string raw;
+    if (!readExact(file_, &payload[0], payload.size()) ||
+        !decompressBlock(info.codec, payload, info.rawSize, raw)) {
+        return false;
+    }
+
+    size_t pos = 0;
+    out.reserve(info.recordCount);
+    while (pos < raw.size()) {
+        if (raw.size() - pos < kGroupHeaderSize) return false;
+        const char* p = raw.data() + pos;
+        uint64_t wakeup = getLE(p, 8);
+        uint32_t byteTimeNs = static_cast<uint32_t>(getLE(p + 8, 4));
+        uint16_t channel = static_cast<uint16_t>(getLE(p + 12, 2));
+        uint32_t count = static_cast<uint32_t>(getLE(p + 14, 2));
+        uint64_t entriesLength = getLE(p + 16, 4);
+        uint64_t dataLength = getLE(p + 20, 4);
+        pos += kGroupHeaderSize;
+        if (entriesLength + dataLength > raw.size() - pos) return false;
+
+        const char* entry = raw.data() + pos;
+        const char* entriesEnd = entry + entriesLength;
+        const char* data = entriesEnd;
+        uint64_t used = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            uint64_t delta, gap, length;
+            if (!getVarint(entry, entriesEnd, delta) || !getVarint(entry, entriesEnd, gap) ||
+                !getVarint(entry, entriesEnd, length) || length > dataLength - used) {
+                return false;
+            }
+            wakeup += delta;
+            CaptureRecord rec;
+            rec.ts.wakeupNs = wakeup;
+            rec.ts.firstByteNs = gap < wakeup ? wakeup - gap : 0;
+            rec.ts.byteTimeNs = byteTimeNs;
+            rec.channel = channel;
+            rec.data.assign(data + used, length);
+            used += length;
+            out.push_back(std::move(rec));
+        }
+        if (entry != entriesEnd || used != dataLength) return false;
+        pos += entriesLength + dataLength;
+    }
+
+    // Groups of different channels overlap in time
+    std::stable_sort(out.begin(), out.end(), [](const CaptureRecord& a, const CaptureRecord& b) {
+        return a.ts.wakeupNs < b.ts.wakeupNs;
+    });
+    return true;
+}
+
+bool CaptureReader::replay(uint64_t fromNs, uint64_t toNs, const RecordCallback& cb) {
+    return search("", fromNs, toNs, cb);
+}
+
+bool CaptureReader::search(const std::string& needle, uint64_t fromNs, uint64_t toNs,
+                           const RecordCallback& cb) {
+    // A match can span several read batches, so the last needle.size() - 1
+    // bytes of each channel are carried into its next record, together with
+    // the records they came from. The record a match starts in is reported,
+    // once, when the match completes.
+    struct Held {
+        CaptureRecord rec;
+        size_t tailBytes = 0; // Trailing bytes of rec.data that are in the carry
+        bool reported = false;
+    };
+    struct Carry {
+        std::string tail;
+        std::deque<Held> held;
+    };
+    std::map<uint16_t, Carry> carries;
+    const size_t keep = needle.empty() ? 0 : needle.size() - 1;
+
+    // Only blocks whose time range overlaps the window are decompressed.
+    // Walk the whole index: with several ports feeding one capture the block
+    // ranges can overlap slightly, so they are not strictly sorted.
+    std::vector<CaptureRecord> records;
+    for (size_t i = 0; i < blocks_.size(); i++) {
+        if (blocks_[i].lastNs < fromNs || blocks_[i].firstNs > toNs) continue;
+        if (!readBlock(i, records)) return false;
+        for (auto& rec : records) {
+            if (rec.ts.wakeupNs < fromNs || rec.ts.wakeupNs > toNs) continue;
+            if (needle.empty()) {
+                if (!cb(rec)) return true;
+                continue;
+            }
+
+            auto& carry = carries[rec.channel];
+            std::string text = carry.tail + rec.data;
+            std::vector<bool> startsIn(carry.held.size() + 1, false);
+            for (size_t at = text.find(needle); at != std::string::npos;
+                 at = text.find(needle, at + 1)) {
+                // A whole match never fits in the carry, so each one is new
+                size_t k = carry.held.size();
+                size_t offset = 0;
+                for (size_t h = 0; h < carry.held.size(); h++) {
+                    offset += carry.held[h].tailBytes;
+                    if (at < offset) {
+                        k = h;
+                        break;
+                    }
+                }
+                startsIn[k] = true;
+            }
+
+            for (size_t h = 0; h < carry.held.size(); h++) {
+                if (startsIn[h] && !carry.held[h].reported) {
+                    carry.held[h].reported = true;
+                    if (!cb(carry.held[h].rec)) return true;
+                }
+            }
+            bool reported = startsIn.back();
+            if (reported && !cb(rec)) return true;
+
+            // Keep the last `keep` bytes and the records they belong to
+            if (keep == 0) continue;
+            Held held;
+            held.tailBytes = rec.data.size();
+            held.reported = reported;
+            held.rec = std::move(rec);
+            carry.held.push_back(std::move(held));
+            size_t excess = text.size() > keep ? text.size() - keep : 0;
+            while (!carry.held.empty() && (excess > 0 || carry.held.front().tailBytes == 0)) {
+                auto& front = carry.held.front();
+                if (front.tailBytes > excess) {
+                    front.tailBytes -= excess;
+                    break;
+                }
+                excess -= front.tailBytes;
+                carry.held.pop_front();
+            }
+            carry.tail = text.substr(text.size() - std::min(text.size(), keep));
+        }
+    }
+    return true;
+}
+
+} // namespace hw_analyzer
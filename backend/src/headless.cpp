@@ -0,0 +1,457 @@
+#include "headless.hpp"
+#include "serial_interface.hpp"
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+#include <cctype>
+#include <csignal>
+#include <algorithm>
+#include <cstdio>
+#include <cerrno>
+#include <climits>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <thread>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+namespace hw_analyzer {
+
+namespace {
+
+std::atomic<bool> g_stop{false};
+
+void onSignal(int) {
+    g_stop = true;
+}
+
+// Looks for a pattern in a stream that arrives in arbitrary batches
+class TriggerMatcher {
+public:
+    explicit TriggerMatcher(const std::string& pattern) : pattern_(pattern) {}
+
+    bool feed(const std::string& data) {
+        if (pattern_.empty()) return false;
+        std::string window = tail_ + data;
+        if (window.find(pattern_) != std::string::npos) {
+            tail_.clear();
+            return true;
+        }
+        size_t keep = std::min(window.size(), pattern_.size() - 1);
+        tail_ = window.substr(window.size() - keep);
+        return false;
+    }
+
+private:
+    std::string pattern_;
+    std::string tail_;
+};
+
+bool parseNumber(const char* text, double& value) {
+    char* end = nullptr;
+    value = std::strtod(text, &end);
+    return end != text && *end == '\0' && value >= 0;
+}
+
+bool parseInt(const char* text, int& value) {
+    double d;
+    if (!parseNumber(text, d) || d > INT_MAX || d != static_cast<int>(d)) return false;
+    value = static_cast<int>(d);
+    return true;
+}
+
+// "NAME" or "NAME:BAUD"; the suffix must be numeric so "COM3" stays intact
+bool parsePort(const std::string& arg, HeadlessPort& port) {
+    port.name = arg;
+    size_t colon = arg.rfind(':');
+    if (colon != std::string::npos && colon + 1 < arg.size() &&
+        arg.find_first_not_of("0123456789", colon + 1) == std::string::npos) {
+        port.name = arg.substr(0, colon);
+        if (!parseInt(arg.c_str() + colon + 1, port.baud) || port.baud <= 0) return false;
+    }
+    return true;
+}
+
+// Raw output written on its own thread, so a slow file or stdout pipe never
+// blocks the port readers. Beyond kMaxQueuedBytes data is dropped and counted.
+class RawWriter {
+public:
+    struct Stats {
+        uint64_t bytes = 0;        // Handed to append()
+        uint64_t writtenBytes = 0;
+        uint64_t droppedBytes = 0;
+        bool writeError = false;
+    };
+
+    RawWriter(std::FILE* file, const ThreadPlacement& placement) : file_(file), placement_(placement) {
+        worker_ = std::thread([this]() { run(); });
+    }
+
+    ~RawWriter() { close(); }
+
+    void append(const std::string& data) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        stats_.bytes += data.size();
+        if (queuedBytes_ + data.size() > kMaxQueuedBytes) {
+            stats_.droppedBytes += data.size();
+            return;
+        }
+        queuedBytes_ += data.size();
+        queue_.push_back(data);
+        cv_.notify_one();
+    }
+
+    // Writes out everything queued and flushes
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        cv_.notify_one();
+        if (worker_.joinable()) worker_.join();
+    }
+
+    Stats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+private:
+    static constexpr size_t kMaxQueuedBytes = 16 * 1024 * 1024;
+
+    void run() {
+        applyThreadPlacement(placement_, "raw writer");
+        std::deque<std::string> batch;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) break;
+            batch.swap(queue_);
+            lock.unlock();
+
+            uint64_t written = 0;
+            uint64_t bytes = 0;
+            for (const auto& data : batch) {
+                bytes += data.size();
+                written += std::fwrite(data.data(), 1, data.size(), file_);
+            }
+            batch.clear();
+            bool ok = written == bytes;
+
+            lock.lock();
+            queuedBytes_ -= bytes;
+            stats_.writtenBytes += written;
+            if (!ok && !stats_.writeError) {
+                stats_.writeError = true;
+                std::cerr << "[Headless] Write failed: " << std::strerror(errno) << std::endl;
+            }
+        }
+        if (std::fflush(file_) != 0) stats_.writeError = true;
+    }
+
+    std::FILE* file_;
+    ThreadPlacement placement_;
+    std::thread worker_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::string> queue_;
+    size_t queuedBytes_ = 0;
+    bool stopping_ = false;
+    Stats stats_;
+};
+
+} // namespace
+
+bool isHeadless(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--headless") == 0) return true;
+    }
+    return false;
+}
+
+bool parseHeadlessArgs(int argc, char* argv[], HeadlessOptions& options, std::string& error) {
+    if (!CaptureWriter::codecAvailable(options.codec)) {
+        options.codec = CaptureCodec::None;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--headless") continue;
+
+        bool consumed = false;
+        if (parseTuningOption(arg, i + 1 < argc ? argv[i + 1] : nullptr, options.tuning, &consumed, error)) {
+            if (!error.empty()) return false;
+            if (consumed) i++;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            error = "Missing value for " + arg;
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if (arg == "--port") {
+            HeadlessPort port;
+            if (!parsePort(value, port)) {
+                error = std::string("Invalid baud rate in --port ") + value;
+                return false;
+            }
+            options.ports.push_back(port);
+        } else if (arg == "--baud") {
+            if (!parseInt(value, options.baud) || options.baud <= 0) {
+                error = "Invalid baud rate";
+                return false;
+            }
+        } else if (arg == "--data-bits") {
+            if (!parseInt(value, options.dataBits) || options.dataBits < 5 || options.dataBits > 8) {
+                error = "Data bits must be 5-8";
+                return false;
+            }
+        } else if (arg == "--parity") {
+            options.parity = static_cast<char>(std::toupper(static_cast<unsigned char>(value[0])));
+            if (std::strlen(value) != 1 || std::strchr("NEO", options.parity) == nullptr) {
+                error = "Parity must be N, E or O";
+                return false;
+            }
+        } else if (arg == "--stop-bits") {
+            if (!parseInt(value, options.stopBits) || (options.stopBits != 1 && options.stopBits != 2)) {
+                error = "Stop bits must be 1 or 2";
+                return false;
+            }
+        } else if (arg == "--output") {
+            options.output = value;
+        } else if (arg == "--format") {
+            if (std::strcmp(value, "raw") == 0) options.rawOutput = true;
+            else if (std::strcmp(value, "capture") == 0) options.rawOutput = false;
+            else {
+                error = "Format must be capture or raw";
+                return false;
+            }
+        } else if (arg == "--codec") {
+            if (!CaptureWriter::parseCodec(value, options.codec) ||
+                !CaptureWriter::codecAvailable(options.codec)) {
+                error = std::string("Codec not available: ") + value;
+                return false;
+            }
+        } else if (arg == "--trigger") {
+            options.startTrigger = value;
+        } else if (arg == "--stop-trigger") {
+            options.stopTrigger = value;
+        } else if (arg == "--duration") {
+            if (!parseNumber(value, options.duration)) {
+                error = "Invalid duration";
+                return false;
+            }
+        } else if (arg == "--stats-interval") {
+            if (!parseNumber(value, options.statsInterval)) {
+                error = "Invalid stats interval";
+                return false;
+            }
+        } else {
+            error = "Unknown option " + arg;
+            return false;
+        }
+    }
+
+    if (options.ports.empty()) {
+        error = "At least one --port is required";
+        return false;
+    }
+    return true;
+}
+
+int runHeadless(const HeadlessOptions& options) {
+    using Clock = std::chrono::steady_clock;
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    // Before any capture thread or buffer exists, so all of them are locked
+    if (options.tuning.lockMemory) {
+        lockProcessMemory();
+    }
+
+    CaptureWriter writer;
+    writer.setThreadPlacement(options.tuning.publisher());
+
+    // Output: capture file (compressed off the capture path) or raw bytes,
+    // both written by a background thread
+    std::FILE* raw = nullptr;
+    std::unique_ptr<RawWriter> rawWriter;
+    if (options.rawOutput) {
+        if (options.output == "-") {
+            raw = stdout;
+#ifdef _WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        } else {
+            raw = std::fopen(options.output.c_str(), "wb");
+        }
+        if (!raw) {
+            std::cerr << "[Headless] Failed to open " << options.output << std::endl;
+            return 1;
+        }
+        rawWriter = std::make_unique<RawWriter>(raw, options.tuning.publisher());
+    } else if (!writer.open(options.output, options.codec)) {
+        return 1;
+    }
+
+    std::atomic<bool> triggered{options.startTrigger.empty()};
+    std::atomic<bool> stopTriggered{false};
+
+    std::vector<std::unique_ptr<SerialInterface>> serials;
+    std::vector<std::unique_ptr<TriggerMatcher>> startMatchers;
+    std::vector<std::unique_ptr<TriggerMatcher>> stopMatchers;
+    int status = 0;
+
+    for (size_t i = 0; i < options.ports.size(); i++) {
+        const auto& port = options.ports[i];
+        auto serial = std::make_unique<SerialInterface>();
+        serial->setDataBits(options.dataBits);
+        serial->setParity(options.parity);
+        serial->setStopBits(options.stopBits);
+        serial->setThreadPlacement(options.tuning.reader(i));
+        // Errors already name the port
+        serial->setErrorCallback([](const std::string& error) {
+            std::cerr << "[Headless] " << error << std::endl;
+        });
+
+        startMatchers.push_back(std::make_unique<TriggerMatcher>(options.startTrigger));
+        stopMatchers.push_back(std::make_unique<TriggerMatcher>(options.stopTrigger));
+        TriggerMatcher* startMatcher = startMatchers.back().get();
+        TriggerMatcher* stopMatcher = stopMatchers.back().get();
+        uint16_t channel = static_cast<uint16_t>(i);
+
+        // Runs on the port's read thread. The batch that completes a trigger
+        // is included in the capture.
+        serial->setDataCallback([&, startMatcher, stopMatcher, channel](const std::string& data,
+                                                                       const RxTimestamp& ts) {
+            if (stopTriggered) return;
+            if (!triggered) {
+                if (!startMatcher->feed(data)) return;
+                if (!triggered.exchange(true)) {
+                    std::cerr << "[Headless] Start trigger on " << options.ports[channel].name << std::endl;
+                }
+            }
+
+            if (rawWriter) {
+                rawWriter->append(data);
+            } else {
+                writer.append(data, ts, channel);
+            }
+
+            if (stopMatcher->feed(data)) {
+                stopTriggered = true;
+            }
+        });
+
+        int baud = port.baud > 0 ? port.baud : options.baud;
+        if (!serial->open(port.name, baud)) {
+            status = 1;
+            break;
+        }
+        std::cerr << "[Headless] Channel " << i << ": " << port.name << " @ " << baud << " "
+                  << options.dataBits << options.parity << options.stopBits << std::endl;
+        serials.push_back(std::move(serial));
+    }
+
+    std::vector<uint64_t> lastBytes(serials.size(), 0);
+    auto printStats = [&](double seconds) {
+        for (size_t i = 0; i < serials.size(); i++) {
+            SerialStats st = serials[i]->stats();
+            double rate = seconds > 0 ? (st.bytes - lastBytes[i]) / seconds : 0;
+            lastBytes[i] = st.bytes;
+            std::cerr << "[Stats] " << options.ports[i].name << ": " << st.bytes << " B, "
+                      << std::fixed << std::setprecision(1) << rate / 1024.0 << " KiB/s, "
+                      << st.batches << " reads, overruns ";
+            if (st.overruns >= 0) std::cerr << st.overruns;
+            else std::cerr << "n/a";
+            if (st.jitterSamples > 0) {
+                std::cerr << ", wakeup jitter avg " << st.jitterAvgNs / 1000.0
+                          << " us max " << st.jitterMaxNs / 1000.0 << " us";
+            }
+            std::cerr << std::endl;
+        }
+        if (rawWriter) {
+            RawWriter::Stats rs = rawWriter->stats();
+            std::cerr << "[Stats] raw: " << rs.bytes << " B -> " << rs.writtenBytes << " B written, "
+                      << rs.droppedBytes << " B dropped" << (rs.writeError ? ", write error" : "") << std::endl;
+        } else {
+            CaptureWriter::Stats ws = writer.stats();
+            std::cerr << "[Stats] capture: " << ws.records << " records, " << ws.rawBytes
+                      << " B -> " << ws.writtenBytes << " B written, "
+                      << ws.droppedRecords << " dropped" << (ws.writeError ? ", write error" : "") << std::endl;
+        }
+    };
+
+    auto lastStats = Clock::now();
+    bool allDisconnected = false;
+    if (status == 0) {
+        for (auto& serial : serials) {
+            serial->startReadLoop();
+        }
+
+        auto start = Clock::now();
+        lastStats = start;
+        while (!g_stop && !stopTriggered) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            auto now = Clock::now();
+            if (options.duration > 0 &&
+                std::chrono::duration<double>(now - start).count() >= options.duration) {
+                break;
+            }
+            double sinceStats = std::chrono::duration<double>(now - lastStats).count();
+            if (options.statsInterval > 0 && sinceStats >= options.statsInterval) {
+                printStats(sinceStats);
+                lastStats = now;
+            }
+            // Nothing more can arrive; the capture so far is kept
+            bool anyReading = false;
+            for (auto& serial : serials) {
+                anyReading = anyReading || serial->isReading();
+            }
+            if (!anyReading) {
+                std::cerr << "[Headless] All ports disconnected, stopping" << std::endl;
+                allDisconnected = true;
+                break;
+            }
+        }
+        if (stopTriggered) {
+            std::cerr << "[Headless] Stop trigger seen" << std::endl;
+        }
+
+        for (auto& serial : serials) {
+            serial->stopReadLoop();
+        }
+    }
+
+    for (auto& serial : serials) {
+        serial->close();
+    }
+    // Finish the output first so the final summary counts every byte written
+    if (rawWriter) {
+        rawWriter->close();
+    } else {
+        writer.close();
+    }
+    if (status == 0) {
+        printStats(std::chrono::duration<double>(Clock::now() - lastStats).count());
+        bool writeFailed = rawWriter ? rawWriter->stats().writeError : writer.stats().writeError;
+        if (writeFailed || allDisconnected) status = 1;
+    }
+    if (raw && raw != stdout) {
+        std::fclose(raw);
+    }
+    return status;
+}
+
+} // namespace hw_analyzer
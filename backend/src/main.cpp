@@ -1,29 +1,279 @@
 #include "serial_interface.hpp"
 #include "websocket_server.hpp"
+#include "capture_file.hpp"
+#include "shm_ring.hpp"
+#include "headless.hpp"
+#include "replay.hpp"
 #include <iostream>
 #include <memory>
+#include <sstream>
+#include <map>
+#include <mutex>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
 
 using namespace hw_analyzer;
 
+namespace {
+
+const char kShmRingPrefix[] = "/hw_analyzer_rx_";
+
+std::atomic<bool> g_stop{false};
+
+void onSignal(int) {
+    g_stop = true;
+}
+
+// Minimal JSON field extraction for the command protocol
+
+// Reads the string value of "key", undoing \" \\ and \n escapes
+bool jsonString(const std::string& msg, const std::string& key, std::string& out) {
+    size_t pos = msg.find("\"" + key + "\":\"");
+    if (pos == std::string::npos) return false;
+    out.clear();
+    for (pos += key.size() + 4; pos < msg.size() && msg[pos] != '"'; pos++) {
+        if (msg[pos] == '\\' && pos + 1 < msg.size()) {
+            char c = msg[++pos];
+            out += (c == 'n') ? '\n' : c;
+        } else {
+            out += msg[pos];
+        }
+    }
+    return true;
+}
+
+// Returns the raw text between the brackets of "key":[...]
+std::string jsonArray(const std::string& msg, const std::string& key) {
+    size_t pos = msg.find("\"" + key + "\":[");
+    if (pos == std::string::npos) return "";
+    pos += key.size() + 4;
+    size_t end = msg.find(']', pos);
+    return end == std::string::npos ? "" : msg.substr(pos, end - pos);
+}
+
+std::vector<std::string> jsonStringArray(const std::string& msg, const std::string& key) {
+    std::vector<std::string> values;
+    std::string array = jsonArray(msg, key);
+    size_t pos = 0;
+    while ((pos = array.find('"', pos)) != std::string::npos) {
+        size_t end = array.find('"', pos + 1);
+        if (end == std::string::npos) break;
+        values.push_back(array.substr(pos + 1, end - pos - 1));
+        pos = end + 1;
+    }
+    return values;
+}
+
+// Parses a whole decimal integer within [minValue, maxValue]; surrounding
+// whitespace is allowed, anything else is rejected
+bool parseInteger(const std::string& text, long long minValue, long long maxValue, long long& value) {
+    const char* begin = text.c_str();
+    char* end = nullptr;
+    errno = 0;
+    long long v = std::strtoll(begin, &end, 10);
+    if (end == begin || errno == ERANGE || v < minValue || v > maxValue) return false;
+    while (*end == ' ' || *end == '\t' || *end == '\n' || *end == '\r') end++;
+    if (*end != '\0') return false;
+    value = v;
+    return true;
+}
+
+// Reads "key":[n, ...]; false if any item is not an integer in range
+bool jsonIntArray(const std::string& msg, const std::string& key, long long minValue, long long maxValue,
+                  std::vector<int>& out) {
+    out.clear();
+    std::stringstream array(jsonArray(msg, key));
+    std::string item;
+    while (std::getline(array, item, ',')) {
+        if (item.find_first_not_of(" \t\n\r") == std::string::npos) continue;
+        long long value;
+        if (!parseInteger(item, minValue, maxValue, value)) return false;
+        out.push_back(static_cast<int>(value));
+    }
+    return true;
+}
+
+// A "record" path must stay inside the capture directory: relative, no ".."
+// component, no drive letter, and not "-" (stdout carries the log)
+bool isSafeCapturePath(const std::string& path) {
+    if (path.empty() || path == "-" || path[0] == '/' || path[0] == '\\' ||
+        (path.size() >= 2 && path[1] == ':')) {
+        return false;
+    }
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = path.find_first_of("/\\", start);
+        if (end == std::string::npos) end = path.size();
+        if (path.compare(start, end - start, "..") == 0 && end - start == 2) return false;
+        start = end + 1;
+    }
+    return true;
+}
+
+// Wall-clock time minus the RX timestamp clock, in microseconds, so a client
+// can show "ts"/"t0" as dates. The two clocks drift apart slowly (NTP slews
+// only the wall clock), so it is sampled again on each open.
+long long clockOffsetUs() {
+    uint64_t before = SerialInterface::monotonicNs();
+    auto wall = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    uint64_t after = SerialInterface::monotonicNs();
+    return static_cast<long long>(wall) - static_cast<long long>((before + (after - before) / 2) / 1000);
+}
+
+bool makeDirectory(const std::string& path) {
+#ifdef _WIN32
+    return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+// --compress off|requested|always, --compress-min-size N, --compress-level 1-9,
+// --no-context-takeover. Returns false if arg is not a compression option.
+bool parseCompressionOption(const std::string& arg, const char* value, CompressionOptions& options,
+                            bool* consumedValue, std::string& error) {
+    *consumedValue = false;
+    if (arg == "--no-context-takeover") {
+        options.contextTakeover = false;
+        return true;
+    }
+    if (arg != "--compress" && arg != "--compress-min-size" && arg != "--compress-level") {
+        return false;
+    }
+    if (!value) {
+        error = "Missing value for " + arg;
+        return true;
+    }
+    *consumedValue = true;
+
+    long long number;
+    if (arg == "--compress") {
+        std::string mode = value;
+        if (mode == "off") options.mode = CompressionOptions::Mode::Off;
+        else if (mode == "requested") options.mode = CompressionOptions::Mode::Requested;
+        else if (mode == "always") options.mode = CompressionOptions::Mode::Always;
+        else error = "Compression must be off, requested or always";
+    } else if (arg == "--compress-min-size") {
+        if (parseInteger(value, 0, 16 * 1024 * 1024, number)) options.minFrameSize = static_cast<size_t>(number);
+        else error = "Invalid minimum compressed message size";
+    } else {
+        if (parseInteger(value, 1, 9, number)) options.level = static_cast<int>(number);
+        else error = "Compression level must be 1-9";
+    }
+    return true;
+}
+
+} // namespace
+
 int main(int argc, char* argv[]) {
+    if (isReplay(argc, argv)) {
+        ReplayOptions options;
+        std::string error;
+        if (!parseReplayArgs(argc, argv, options, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 2;
+        }
+        return runReplay(options);
+    }
+
+    if (isHeadless(argc, argv)) {
+        HeadlessOptions options;
+        std::string error;
+        if (!parseHeadlessArgs(argc, argv, options, error)) {
+            std::cerr << "Error: " << error << std::endl;
+            return 2;
+        }
+        return runHeadless(options);
+    }
+
+    TuningOptions tuning;
+    CompressionOptions compression;
+    std::string captureDir = "captures";
+    for (int i = 1; i < argc; i++) {
+        bool consumed = false;
+        std::string error;
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::string(argv[i]) == "--capture-dir") {
+            if (!value || !*value) {
+                std::cerr << "Error: Missing value for --capture-dir" << std::endl;
+                return 2;
+            }
+            captureDir = value;
+            i++;
+            continue;
+        }
+        bool known = parseTuningOption(argv[i], value, tuning, &consumed, error) ||
+                     parseCompressionOption(argv[i], value, compression, &consumed, error);
+        if (!known || !error.empty()) {
+            std::cerr << "Error: " << (error.empty() ? "Unknown option " + std::string(argv[i]) : error) << std::endl;
+            return 2;
+        }
+        if (consumed) i++;
+    }
+
     std::cout << "HW Analyzer Backend Starting..." << std::endl;
     std::cout << "WebSocket server will listen on ws://localhost:9001" << std::endl;
+
+    if (tuning.lockMemory) {
+        lockProcessMemory();
+    }
     
     auto server = std::make_unique<WebSocketServer>(9001);
     auto serial = std::make_shared<SerialInterface>();
+    auto recorder = std::make_shared<CaptureWriter>();
+    auto ring = std::make_shared<ShmRing>();
+
+    // Subscriptions of clients reading RX through the ring, restored when
+    // they switch back to the socket
+    std::map<int, Subscription> shmClients;
+    std::mutex shmMutex;
+
+    serial->setThreadPlacement(tuning.reader(0));
+    server->setPublisherPlacement(tuning.publisher());
+    server->setCompression(compression);
+    recorder->setThreadPlacement(tuning.publisher());
     
     // Set up serial data callback
-    serial->setDataCallback([&server](const std::string& data) {
-        // Send received data to all connected clients
-        server->broadcast(R"({"type":"rx","data":")" + data + "\"}");
+    serial->setDataCallback([&server, &recorder, &ring, &serial](const std::string& data, const RxTimestamp& ts) {
+        recorder->append(data, ts);
+        ring->write(data, ts);
+
+        // Send received data to subscribed clients, stamped in microseconds
+        Publication pub;
+        pub.type = "rx";
+        pub.port = serial->portName();
+        pub.data = data;
+        pub.json = R"({"type":"rx","port":")" + pub.port +
+                   R"(","channel":0,"data":")" + data +
+                   R"(","ts":)" + std::to_string(ts.wakeupNs / 1000) +
+                   R"(,"t0":)" + std::to_string(ts.firstByteNs / 1000) +
+                   R"(,"byteNs":)" + std::to_string(ts.byteTimeNs) + "}";
+        server->publish(std::move(pub));
     });
     
     serial->setErrorCallback([&server](const std::string& error) {
-        server->broadcast(R"({"type":"error","message":")" + error + "\"}");
+        Publication pub;
+        pub.type = "error";
+        pub.data = error;
+        pub.json = R"({"type":"error","message":")" + error + "\"}";
+        server->publish(std::move(pub));
     });
     
     // Handle WebSocket messages
-    server->setMessageHandler([&serial](const std::string& message) -> std::string {
+    server->setMessageHandler([&server, &serial, &recorder, &ring, &shmClients, &shmMutex, &captureDir](int clientId, const std::string& message) -> std::string {
         std::cout << "Received: " << message << std::endl;
         
         // Simple JSON parsing (for MVP - use nlohmann/json in production)
@@ -50,11 +300,15 @@ int main(int argc, char* argv[]) {
                 
                 baudPos += 7; // length of "baud":
                 size_t baudEnd = message.find_first_of(",}", baudPos);
-                int baud = std::stoi(message.substr(baudPos, baudEnd - baudPos));
+                long long baud;
+                if (!parseInteger(message.substr(baudPos, baudEnd - baudPos), 1, INT_MAX, baud)) {
+                    return R"({"type":"error","message":"Invalid baud rate"})";
+                }
                 
-                if (serial->open(port, baud)) {
+                if (serial->open(port, static_cast<int>(baud))) {
                     serial->startReadLoop();
-                    return R"({"type":"status","message":"Port opened successfully"})";
+                    return R"({"type":"status","message":"Port opened successfully","clockOffsetUs":)" +
+                           std::to_string(clockOffsetUs()) + "}";
                 }
                 return R"({"type":"error","message":"Failed to open port"})";
             }
@@ -84,12 +338,178 @@ int main(int argc, char* argv[]) {
             serial->close();
             return R"({"type":"status","message":"Port closed"})";
         }
+        else if (message.find("\"cmd\":\"subscribe\"") != std::string::npos) {
+            Subscription sub;
+            sub.types = jsonStringArray(message, "types");
+            sub.ports = jsonStringArray(message, "ports");
+            std::vector<int> bytes;
+            if (!jsonIntArray(message, "channels", 0, 65535, sub.channels)) {
+                return R"({"type":"error","message":"Channels must be integers 0-65535"})";
+            }
+            if (!jsonIntArray(message, "bytes", 0, 255, bytes) || (!bytes.empty() && bytes.size() != 2)) {
+                return R"({"type":"error","message":"Byte range must be two integers 0-255"})";
+            }
+            if (bytes.size() == 2) {
+                sub.byteMin = bytes[0];
+                sub.byteMax = bytes[1];
+            }
+            jsonString(message, "regex", sub.regex);
+
+            std::string error;
+            if (!sub.compile(error)) {
+                return R"({"type":"error","message":")" + error + "\"}";
+            }
+            server->setSubscription(clientId, sub);
+            return R"({"type":"status","message":"Subscription updated"})";
+        }
+        else if (message.find("\"cmd\":\"unsubscribe\"") != std::string::npos) {
+            server->setSubscription(clientId, Subscription());
+            return R"({"type":"status","message":"Receiving all messages"})";
+        }
+        else if (message.find("\"cmd\":\"stats\"") != std::string::npos) {
+            SerialStats st = serial->stats();
+            return R"({"type":"stats","port":")" + serial->portName() +
+                   R"(","bytes":)" + std::to_string(st.bytes) +
+                   R"(,"batches":)" + std::to_string(st.batches) +
+                   R"(,"overruns":)" + std::to_string(st.overruns) +
+                   R"(,"jitterAvgUs":)" + std::to_string(st.jitterAvgNs / 1000.0) +
+                   R"(,"jitterMaxUs":)" + std::to_string(st.jitterMaxNs / 1000.0) +
+                   R"(,"jitterSamples":)" + std::to_string(st.jitterSamples) +
+                   R"(,"recordDropped":)" + std::to_string(recorder->stats().droppedRecords) +
+                   R"(,"shmDropped":)" + std::to_string(ring->dropped()) +
+                   R"(,"publishDropped":)" + std::to_string(server->droppedPublications()) +
+                   R"(,"clientDropped":)" + std::to_string(server->droppedFrames()) + "}";
+        }
+        else if (message.find("\"cmd\":\"shm\"") != std::string::npos) {
+            std::lock_guard<std::mutex> lock(shmMutex);
+            if (message.find("\"enable\":false") != std::string::npos) {
+                auto saved = shmClients.find(clientId);
+                if (saved != shmClients.end()) {
+                    server->setSubscription(clientId, saved->second);
+                    shmClients.erase(saved);
+                }
+                if (shmClients.empty()) {
+                    ring->close();
+                }
+                return R"({"type":"status","message":"Shared memory transport closed"})";
+            }
+
+            long long size = 16 * 1024 * 1024;
+            size_t sizePos = message.find("\"size\":");
+            if (sizePos != std::string::npos) {
+                sizePos += 7; // length of "size":
+                size_t sizeEnd = message.find_first_of(",}", sizePos);
+                if (!parseInteger(message.substr(sizePos, sizeEnd - sizePos),
+                                  static_cast<long long>(kShmRingMinCapacity),
+                                  static_cast<long long>(kShmRingMaxCapacity), size)) {
+                    return R"({"type":"error","message":"Ring size must be )" +
+                           std::to_string(kShmRingMinCapacity) + " to " +
+                           std::to_string(kShmRingMaxCapacity) + " bytes\"}";
+                }
+            }
+#ifdef _WIN32
+            std::string name = "hw_analyzer_rx";
+#else
+            std::string name = kShmRingPrefix + std::to_string(getpid());
+#endif
+            // While other clients read the ring it is shared as is
+            bool shared = shmClients.size() > shmClients.count(clientId);
+            if ((!ring->isOpen() || !shared) && !ring->create(name, static_cast<size_t>(size))) {
+                return R"({"type":"error","message":"Failed to create shared memory ring"})";
+            }
+
+            // RX now arrives through the ring; keep only control traffic here
+            if (shmClients.find(clientId) == shmClients.end()) {
+                Subscription previous;
+                server->getSubscription(clientId, previous);
+                shmClients[clientId] = previous;
+            }
+            Subscription control;
+            control.types = {"error"};
+            std::string error;
+            control.compile(error);
+            server->setSubscription(clientId, control);
+
+            return R"({"type":"shm","name":")" + ring->name() +
+                   R"(","size":)" + std::to_string(ring->capacity()) + "}";
+        }
+        else if (message.find("\"cmd\":\"record\"") != std::string::npos) {
+            // Any peer can send this, so it may only name a file inside
+            // the capture directory
+            std::string path;
+            if (!jsonString(message, "path", path)) {
+                return R"({"type":"error","message":"Missing capture path"})";
+            }
+            if (!isSafeCapturePath(path)) {
+                return R"({"type":"error","message":"Capture path must be relative to the capture directory, without .."})";
+            }
+
+            CaptureCodec codec = CaptureWriter::codecAvailable(CaptureCodec::LZ4)
+                ? CaptureCodec::LZ4 : CaptureCodec::None;
+            std::string name;
+            if (jsonString(message, "codec", name) &&
+                (!CaptureWriter::parseCodec(name, codec) || !CaptureWriter::codecAvailable(codec))) {
+                return R"({"type":"error","message":"Unsupported capture codec"})";
+            }
+
+            if (!makeDirectory(captureDir)) {
+                return R"({"type":"error","message":"Failed to create the capture directory"})";
+            }
+            if (recorder->open(captureDir + "/" + path, codec)) {
+                return R"({"type":"status","message":"Recording started"})";
+            }
+            return R"({"type":"error","message":"Failed to open capture file"})";
+        }
+        else if (message.find("\"cmd\":\"stop_record\"") != std::string::npos) {
+            recorder->close();
+            auto stats = recorder->stats();
+            std::string summary = std::to_string(stats.records) + " records, " +
+                                  std::to_string(stats.rawBytes) + " -> " +
+                                  std::to_string(stats.writtenBytes) + " bytes, " +
+                                  std::to_string(stats.droppedRecords) + " dropped";
+            if (stats.writeError) {
+                return R"({"type":"error","message":"Recording stopped after a write error: )" + summary + "\"}";
+            }
+            return R"({"type":"status","message":"Recording stopped: )" + summary + "\"}";
+        }
         
         return R"({"type":"error","message":"Unknown command"})";
     });
     
+    // A client that disconnects without disabling the ring releases it too
+    server->setDisconnectHandler([&ring, &shmClients, &shmMutex](int clientId) {
+        std::lock_guard<std::mutex> lock(shmMutex);
+        if (shmClients.erase(clientId) > 0 && shmClients.empty()) {
+            ring->close();
+        }
+    });
+
+    // Rings of backends that were killed outright are never unlinked
+    ShmRing::removeStale(kShmRingPrefix);
+
+    // SIGINT/SIGTERM stop the server so the ring is unlinked and a running
+    // capture gets its index. The handler only sets a flag.
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    std::thread stopper([&server]() {
+        while (!g_stop) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        server->stop();
+    });
+
     std::cout << "Backend ready. Waiting for connections..." << std::endl;
     server->run();
-    
-    return 0;
+    g_stop = true;
+    stopper.join();
+
+    serial->stopReadLoop();
+    serial->close();
+    recorder->close();
+    ring->close();
+    std::cout << "Backend stopped" << std::endl;
+
+    // Client threads are detached and still use the server: leave without
+    // destroying it
+    std::exit(0);
 }
@@ -0,0 +1,186 @@
+#include "replay.hpp"
+#include "capture_file.hpp"
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+namespace hw_analyzer {
+
+namespace {
+
+bool parseSeconds(const char* text, double& value) {
+    char* end = nullptr;
+    value = std::strtod(text, &end);
+    return end != text && *end == '\0' && value >= 0;
+}
+
+const char* codecName(CaptureCodec codec) {
+    switch (codec) {
+        case CaptureCodec::LZ4: return "lz4";
+        case CaptureCodec::Zstd: return "zstd";
+        default: return "none";
+    }
+}
+
+// Printable ASCII as is, everything else escaped
+std::string escape(const std::string& data) {
+    std::string out;
+    out.reserve(data.size());
+    for (unsigned char c : data) {
+        switch (c) {
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            case '\\': out += "\\\\"; break;
+            default:
+                if (c >= 0x20 && c < 0x7F) {
+                    out += static_cast<char>(c);
+                } else {
+                    char hex[5];
+                    std::snprintf(hex, sizeof(hex), "\\x%02X", c);
+                    out += hex;
+                }
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+bool isReplay(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--replay") == 0) return true;
+    }
+    return false;
+}
+
+bool parseReplayArgs(int argc, char* argv[], ReplayOptions& options, std::string& error) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--info") {
+            options.info = true;
+            continue;
+        }
+
+        if (i + 1 >= argc) {
+            error = "Missing value for " + arg;
+            return false;
+        }
+        const char* value = argv[++i];
+
+        if (arg == "--replay") {
+            options.path = value;
+        } else if (arg == "--from") {
+            if (!parseSeconds(value, options.from)) {
+                error = "Invalid --from time";
+                return false;
+            }
+        } else if (arg == "--to") {
+            if (!parseSeconds(value, options.to)) {
+                error = "Invalid --to time";
+                return false;
+            }
+        } else if (arg == "--search") {
+            options.search = value;
+        } else if (arg == "--channel") {
+            char* end = nullptr;
+            long channel = std::strtol(value, &end, 10);
+            if (end == value || *end != '\0' || channel < 0 || channel > 65535) {
+                error = "Channel must be 0-65535";
+                return false;
+            }
+            options.channel = static_cast<int>(channel);
+        } else if (arg == "--format") {
+            if (std::strcmp(value, "raw") == 0) options.rawOutput = true;
+            else if (std::strcmp(value, "text") == 0) options.rawOutput = false;
+            else {
+                error = "Format must be text or raw";
+                return false;
+            }
+        } else {
+            error = "Unknown option " + arg;
+            return false;
+        }
+    }
+
+    if (options.path.empty()) {
+        error = "--replay needs a capture file";
+        return false;
+    }
+    if (options.to >= 0 && options.to < options.from) {
+        error = "--to is before --from";
+        return false;
+    }
+    return true;
+}
+
+int runReplay(const ReplayOptions& options) {
+    CaptureReader reader;
+    if (!reader.open(options.path)) {
+        std::cerr << "[Replay] Failed to open capture " << options.path << std::endl;
+        return 1;
+    }
+
+    const auto& blocks = reader.blocks();
+    uint64_t startNs = UINT64_MAX;
+    uint64_t records = 0;
+    for (const auto& block : blocks) {
+        startNs = std::min(startNs, block.firstNs);
+        records += block.recordCount;
+    }
+    if (blocks.empty()) startNs = 0;
+
+    if (options.info) {
+        std::cerr << "[Replay] " << options.path << ": " << blocks.size() << " blocks, "
+                  << records << " records" << std::endl;
+        for (size_t i = 0; i < blocks.size(); i++) {
+            const auto& b = blocks[i];
+            std::fprintf(stderr, "[Replay] block %zu: %.6f-%.6f s, %u records, %u -> %u B %s\n", i,
+                         (b.firstNs - startNs) / 1e9, (b.lastNs - startNs) / 1e9, b.recordCount,
+                         b.rawSize, b.compressedSize, codecName(b.codec));
+        }
+    }
+
+#ifdef _WIN32
+    if (options.rawOutput) _setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+    uint64_t fromNs = startNs + static_cast<uint64_t>(options.from * 1e9);
+    uint64_t toNs = options.to < 0 ? UINT64_MAX : startNs + static_cast<uint64_t>(options.to * 1e9);
+    uint64_t matched = 0;
+    bool ok = reader.search(options.search, fromNs, toNs, [&](const CaptureRecord& rec) {
+        if (options.channel >= 0 && rec.channel != options.channel) return true;
+        matched++;
+        if (options.rawOutput) {
+            std::fwrite(rec.data.data(), 1, rec.data.size(), stdout);
+        } else {
+            std::printf("%.6f ch%u %s\n", (rec.ts.wakeupNs - startNs) / 1e9,
+                        static_cast<unsigned>(rec.channel), escape(rec.data).c_str());
+        }
+        return !std::ferror(stdout);
+    });
+    std::fflush(stdout);
+
+    if (!ok) {
+        std::cerr << "[Replay] Capture is corrupt" << std::endl;
+        return 1;
+    }
+    if (std::ferror(stdout)) {
+        std::cerr << "[Replay] Failed to write output" << std::endl;
+        return 1;
+    }
+    if (options.info) {
+        std::cerr << "[Replay] " << matched << " records matched" << std::endl;
+    }
+    return 0;
+}
+
+} // namespace hw_analyzer
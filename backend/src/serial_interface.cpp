@@ -1,6 +1,7 @@
 #include "serial_interface.hpp"
 #include <iostream>
 #include <cstring>
+#include <cerrno>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -10,6 +11,12 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <dirent.h>
+#include <poll.h>
+#include <time.h>
+#endif
+#ifdef __linux__
+#include <linux/serial.h>
+#include "serial_linux_baud.hpp"
 #endif
 
 namespace hw_analyzer {
@@ -27,12 +34,56 @@ public:
     
     std::thread readThread;
     std::atomic<bool> running{false};
+    std::atomic<uint64_t> bytesRead{0};
+    std::atomic<uint64_t> batches{0};
+    std::atomic<uint64_t> jitterSamples{0};
+    std::atomic<uint64_t> jitterSumNs{0};
+    std::atomic<uint64_t> jitterMaxNs{0};
+    ThreadPlacement placement;
+
+    // Read thread only writes these, so plain load/store is enough
+    void recordJitter(uint64_t lateNs) {
+        jitterSamples.store(jitterSamples.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        jitterSumNs.store(jitterSumNs.load(std::memory_order_relaxed) + lateNs, std::memory_order_relaxed);
+        if (lateNs > jitterMaxNs.load(std::memory_order_relaxed)) {
+            jitterMaxNs.store(lateNs, std::memory_order_relaxed);
+        }
+    }
     DataCallback onData;
     ErrorCallback onError;
+
+    // Called by the read thread just before it exits on a dead device
+    void disconnected(const std::string& reason) {
+        running = false;
+        if (onError) {
+            onError(reason + ": " + portName);
+        }
+    }
     
     int currentBaud = 115200;
+    int dataBits = 8;
+    char parity = 'N';
+    int stopBits = 1;
     std::string portName;
 
+    // Wire time of one character: start bit + data + parity + stop bits
+    uint32_t byteTimeNs() const {
+        if (currentBaud <= 0) return 0;
+        int frameBits = 1 + dataBits + (parity == 'N' ? 0 : 1) + stopBits;
+        return static_cast<uint32_t>(frameBits * 1000000000ULL / currentBaud);
+    }
+
+    // The last byte of a batch arrived no later than the wakeup; earlier
+    // bytes are spaced one character time apart before it.
+    RxTimestamp stamp(uint64_t wakeupNs, size_t count) const {
+        RxTimestamp ts;
+        ts.wakeupNs = wakeupNs;
+        ts.byteTimeNs = byteTimeNs();
+        uint64_t span = count > 0 ? (count - 1) * static_cast<uint64_t>(ts.byteTimeNs) : 0;
+        ts.firstByteNs = wakeupNs > span ? wakeupNs - span : 0;
+        return ts;
+    }
+
     void close() {
         running = false;
         if (readThread.joinable()) {
@@ -55,6 +106,28 @@ public:
 SerialInterface::SerialInterface() : pImpl(std::make_unique<Impl>()) {}
 SerialInterface::~SerialInterface() = default;
 
+uint64_t SerialInterface::monotonicNs() {
+#ifdef _WIN32
+    static const LONGLONG freq = [] {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        return f.QuadPart;
+    }();
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return static_cast<uint64_t>(now.QuadPart / freq) * 1000000000ULL +
+           static_cast<uint64_t>(now.QuadPart % freq) * 1000000000ULL / freq;
+#else
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC_RAW
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
 std::vector<SerialPortInfo> SerialInterface::listPorts() {
     std::vector<SerialPortInfo> ports;
     
@@ -101,8 +174,19 @@ std::vector<SerialPortInfo> SerialInterface::listPorts() {
 
 bool SerialInterface::open(const std::string& portName, int baudRate) {
     pImpl->close();
+    if (baudRate <= 0) {
+        if (pImpl->onError) {
+            pImpl->onError("Invalid baud rate " + std::to_string(baudRate) + ": " + portName);
+        }
+        return false;
+    }
     pImpl->portName = portName;
     pImpl->currentBaud = baudRate;
+    pImpl->bytesRead = 0;
+    pImpl->batches = 0;
+    pImpl->jitterSamples = 0;
+    pImpl->jitterSumNs = 0;
+    pImpl->jitterMaxNs = 0;
 
 #ifdef _WIN32
     std::string fullName = "\\\\.\\" + portName;
@@ -128,19 +212,21 @@ bool SerialInterface::open(const std::string& portName, int baudRate) {
     }
     
     dcb.BaudRate = baudRate;
-    dcb.ByteSize = 8;
-    dcb.Parity = NOPARITY;
-    dcb.StopBits = ONESTOPBIT;
+    dcb.ByteSize = pImpl->dataBits;
+    dcb.Parity = pImpl->parity == 'E' ? EVENPARITY : pImpl->parity == 'O' ? ODDPARITY : NOPARITY;
+    dcb.StopBits = pImpl->stopBits == 2 ? TWOSTOPBITS : ONESTOPBIT;
     
     if (!SetCommState(pImpl->handle, &dcb)) {
         close();
         return false;
     }
     
+    // ReadFile returns as soon as any byte is buffered, or after 10 ms with
+    // nothing, so the read thread wakes on arrival and still sees a stop
     COMMTIMEOUTS timeouts = {0};
-    timeouts.ReadIntervalTimeout = 50;
-    timeouts.ReadTotalTimeoutConstant = 50;
-    timeouts.ReadTotalTimeoutMultiplier = 10;
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+    timeouts.ReadTotalTimeoutConstant = 10;
     SetCommTimeouts(pImpl->handle, &timeouts);
     
 #else
@@ -158,22 +244,71 @@ bool SerialInterface::open(const std::string& portName, int baudRate) {
         return false;
     }
     
-    // Set baud rate
-    speed_t speed = B115200;
+    // Set baud rate. Rates without a Bxxx constant go through termios2 on
+    // Linux and are rejected elsewhere, never silently replaced.
+    speed_t speed = 0;
     switch(baudRate) {
         case 9600: speed = B9600; break;
         case 19200: speed = B19200; break;
         case 38400: speed = B38400; break;
         case 57600: speed = B57600; break;
         case 115200: speed = B115200; break;
+#ifdef B230400
+        case 230400: speed = B230400; break;
+#endif
+#ifdef B460800
+        case 460800: speed = B460800; break;
+#endif
+#ifdef B500000
+        case 500000: speed = B500000; break;
+#endif
+#ifdef B921600
+        case 921600: speed = B921600; break;
+#endif
+#ifdef B1000000
+        case 1000000: speed = B1000000; break;
+#endif
+#ifdef B1500000
+        case 1500000: speed = B1500000; break;
+#endif
+#ifdef B2000000
+        case 2000000: speed = B2000000; break;
+#endif
+#ifdef B3000000
+        case 3000000: speed = B3000000; break;
+#endif
+#ifdef B4000000
+        case 4000000: speed = B4000000; break;
+#endif
+    }
+    bool customBaud = speed == 0;
+#ifndef __linux__
+    if (customBaud) {
+        if (pImpl->onError) {
+            pImpl->onError("Unsupported baud rate " + std::to_string(baudRate) + ": " + portName);
+        }
+        close();
+        return false;
+    }
+#endif
+    if (!customBaud) {
+        cfsetospeed(&tty, speed);
+        cfsetispeed(&tty, speed);
     }
-    cfsetospeed(&tty, speed);
-    cfsetispeed(&tty, speed);
     
-    tty.c_cflag = (tty.c_cflag & ~CSIZE) | CS8;
+    tcflag_t size = CS8;
+    switch (pImpl->dataBits) {
+        case 5: size = CS5; break;
+        case 6: size = CS6; break;
+        case 7: size = CS7; break;
+    }
+    tty.c_cflag = (tty.c_cflag & ~CSIZE) | size;
     tty.c_cflag |= (CLOCAL | CREAD);
     tty.c_cflag &= ~(PARENB | PARODD);
+    if (pImpl->parity == 'E') tty.c_cflag |= PARENB;
+    if (pImpl->parity == 'O') tty.c_cflag |= PARENB | PARODD;
     tty.c_cflag &= ~CSTOPB;
+    if (pImpl->stopBits == 2) tty.c_cflag |= CSTOPB;
     tty.c_cflag &= ~CRTSCTS;
     
     tty.c_lflag = 0;
@@ -188,6 +323,15 @@ bool SerialInterface::open(const std::string& portName, int baudRate) {
         close();
         return false;
     }
+#ifdef __linux__
+    if (customBaud && !setLinuxCustomBaud(pImpl->fd, baudRate)) {
+        if (pImpl->onError) {
+            pImpl->onError("Unsupported baud rate " + std::to_string(baudRate) + ": " + portName);
+        }
+        close();
+        return false;
+    }
+#endif
 #endif
     
     return true;
@@ -205,6 +349,10 @@ bool SerialInterface::isOpen() const {
 #endif
 }
 
+std::string SerialInterface::portName() const {
+    return pImpl->portName;
+}
+
 bool SerialInterface::write(const std::string& data) {
     if (!isOpen()) return false;
     
@@ -247,19 +395,98 @@ void SerialInterface::setErrorCallback(ErrorCallback cb) {
 
 void SerialInterface::startReadLoop() {
     if (pImpl->running || !isOpen()) return;
+    // A thread that stopped on a disconnect is still joinable
+    if (pImpl->readThread.joinable()) {
+        pImpl->readThread.join();
+    }
     
     pImpl->running = true;
     pImpl->readThread = std::thread([this]() {
+        applyThreadPlacement(pImpl->placement, "reader " + pImpl->portName);
+        if (processMemoryLocked()) {
+            prefaultStack();
+        }
+
+        // Allocated once, before the loop
+        std::vector<char> buffer(4096);
+#ifndef _WIN32
+        const int idleWaitMs = 10; // Short, so jitter is sampled while idle
+        // Under sustained traffic poll() never times out, so a short timed
+        // sleep is taken this often instead (a few bytes of FIFO at most)
+        const uint64_t probeIntervalNs = 100000000ULL;
+        const long probeSleepNs = 100000;
+        uint64_t lastSample = monotonicNs();
+#endif
         while (pImpl->running) {
-            std::string data = read(256);
-            if (!data.empty() && pImpl->onData) {
-                pImpl->onData(data);
+#ifdef _WIN32
+            // Returns on the first buffered byte (see the timeouts in open())
+            DWORD n = 0;
+            if (!ReadFile(pImpl->handle, buffer.data(), static_cast<DWORD>(buffer.size()), &n, NULL)) {
+                pImpl->disconnected("Read failed");
+                break;
+            }
+            uint64_t wakeup = monotonicNs();
+#else
+            // Block until data is pending so the timestamp reflects the
+            // wakeup, not a polling interval.
+            struct pollfd pfd = { pImpl->fd, POLLIN, 0 };
+            uint64_t waitStart = monotonicNs();
+            int ready = poll(&pfd, 1, idleWaitMs);
+            uint64_t wakeup = monotonicNs();
+            if (ready == 0) {
+                uint64_t expected = waitStart + idleWaitMs * 1000000ULL;
+                pImpl->recordJitter(wakeup > expected ? wakeup - expected : 0);
+                lastSample = wakeup;
+                continue;
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            if (ready < 0) {
+                if (errno == EINTR) continue;
+                pImpl->disconnected(std::string("poll failed: ") + std::strerror(errno));
+                break;
+            }
+            // Data still pending is drained before a hangup is reported
+            if (!(pfd.revents & POLLIN) && (pfd.revents & (POLLHUP | POLLERR | POLLNVAL))) {
+                pImpl->disconnected("Device disconnected");
+                break;
+            }
+            ssize_t n = ::read(pImpl->fd, buffer.data(), buffer.size());
+            if (n == 0) {
+                // Readable but no data: the line hung up
+                pImpl->disconnected("Device disconnected");
+                break;
+            }
+            if (n < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+                pImpl->disconnected(std::string("Read failed: ") + std::strerror(errno));
+                break;
+            }
+#endif
+            if (n > 0) {
+                pImpl->bytesRead.fetch_add(n, std::memory_order_relaxed);
+                pImpl->batches.fetch_add(1, std::memory_order_relaxed);
+                if (pImpl->onData) {
+                    pImpl->onData(std::string(buffer.data(), n), pImpl->stamp(wakeup, n));
+                }
+            }
+#ifndef _WIN32
+            if (wakeup - lastSample >= probeIntervalNs) {
+                struct timespec sleepFor = { 0, probeSleepNs };
+                uint64_t sleepStart = monotonicNs();
+                nanosleep(&sleepFor, nullptr);
+                uint64_t woke = monotonicNs();
+                uint64_t expected = sleepStart + probeSleepNs;
+                pImpl->recordJitter(woke > expected ? woke - expected : 0);
+                lastSample = woke;
+            }
+#endif
         }
     });
 }
 
+void SerialInterface::setThreadPlacement(const ThreadPlacement& placement) {
+    pImpl->placement = placement;
+}
+
 void SerialInterface::stopReadLoop() {
     pImpl->running = false;
     if (pImpl->readThread.joinable()) {
@@ -267,28 +494,61 @@ void SerialInterface::stopReadLoop() {
     }
 }
 
+bool SerialInterface::isReading() const {
+    return pImpl->running;
+}
+
+SerialStats SerialInterface::stats() const {
+    SerialStats st;
+    st.bytes = pImpl->bytesRead.load(std::memory_order_relaxed);
+    st.batches = pImpl->batches.load(std::memory_order_relaxed);
+    st.jitterSamples = pImpl->jitterSamples.load(std::memory_order_relaxed);
+    st.jitterMaxNs = pImpl->jitterMaxNs.load(std::memory_order_relaxed);
+    if (st.jitterSamples > 0) {
+        st.jitterAvgNs = pImpl->jitterSumNs.load(std::memory_order_relaxed) / st.jitterSamples;
+    }
+#if defined(__linux__) && defined(TIOCGICOUNT)
+    struct serial_icounter_struct icount;
+    if (isOpen() && ioctl(pImpl->fd, TIOCGICOUNT, &icount) == 0) {
+        st.overruns = icount.overrun + icount.buf_overrun;
+    }
+#endif
+    return st;
+}
+
 bool SerialInterface::setBaudRate(int baudRate) {
     pImpl->currentBaud = baudRate;
-    if (isOpen()) {
-        std::string port = pImpl->portName;
-        close();
-        return open(port, baudRate);
-    }
-    return true;
+    return reopen();
 }
 
 bool SerialInterface::setDataBits(int bits) {
-    // Implementation for data bits configuration
-    return true;
+    if (bits < 5 || bits > 8) return false;
+    pImpl->dataBits = bits;
+    return reopen();
 }
 
 bool SerialInterface::setParity(char parity) {
-    // Implementation for parity configuration
-    return true;
+    if (parity != 'N' && parity != 'E' && parity != 'O') return false;
+    pImpl->parity = parity;
+    return reopen();
 }
 
 bool SerialInterface::setStopBits(int bits) {
-    // Implementation for stop bits configuration
+    if (bits != 1 && bits != 2) return false;
+    pImpl->stopBits = bits;
+    return reopen();
+}
+
+// Line settings are applied in open(); reopen to change them on a live port
+bool SerialInterface::reopen() {
+    if (!isOpen()) return true;
+    std::string port = pImpl->portName;
+    bool reading = pImpl->running;
+    close();
+    if (!open(port, pImpl->currentBaud)) return false;
+    if (reading) {
+        startReadLoop();
+    }
     return true;
 }
 
@@ -0,0 +1,27 @@
+#include "serial_linux_baud.hpp"
+
+#ifdef __linux__
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+
+namespace hw_analyzer {
+
+bool setLinuxCustomBaud(int fd, int baudRate) {
+    struct termios2 tio;
+    if (ioctl(fd, TCGETS2, &tio) != 0) return false;
+
+    tio.c_cflag &= ~CBAUD;
+    tio.c_cflag |= BOTHER;
+    tio.c_ispeed = static_cast<speed_t>(baudRate);
+    tio.c_ospeed = static_cast<speed_t>(baudRate);
+    if (ioctl(fd, TCSETS2, &tio) != 0) return false;
+
+    // Drivers round to the nearest divisor they support; reject large errors
+    if (ioctl(fd, TCGETS2, &tio) != 0) return false;
+    long actual = static_cast<long>(tio.c_ospeed);
+    long error = actual > baudRate ? actual - baudRate : baudRate - actual;
+    return error * 50 <= baudRate; // Within 2%
+}
+
+} // namespace hw_analyzer
+#endif
@@ -0,0 +1,206 @@
+#include "shm_ring.hpp"
+#include <iostream>
+#include <cstring>
+#include <climits>
+#include <cerrno>
+#include <cstdlib>
+#include <new>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <dirent.h>
+#include <signal.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+namespace hw_analyzer {
+
+namespace {
+
+size_t align8(size_t n) {
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+void ringDoorbell(std::atomic<uint32_t>* word) {
+#ifdef __linux__
+    // Shared (non-private) futex: the waiter lives in another process
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+
+} // namespace
+
+ShmRing::~ShmRing() {
+    close();
+}
+
+bool ShmRing::create(const std::string& name, size_t capacity) {
+    close();
+
+#ifdef _WIN32
+    (void)name;
+    (void)capacity;
+    std::cerr << "[SHM] Shared memory transport is not supported on Windows" << std::endl;
+    return false;
+#else
+    if (capacity < kShmRingMinCapacity || capacity > kShmRingMaxCapacity) {
+        std::cerr << "[SHM] Ring size " << capacity << " is outside " << kShmRingMinCapacity
+                  << "-" << kShmRingMaxCapacity << " bytes" << std::endl;
+        return false;
+    }
+    size_t cap = 4096;
+    while (cap < capacity) cap <<= 1;
+    size_t total = sizeof(ShmRingHeader) + cap;
+
+    // Replace a stale object left behind by a crashed backend
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        std::cerr << "[SHM] Failed to create " << name << std::endl;
+        return false;
+    }
+    if (ftruncate(fd, static_cast<off_t>(total)) != 0) {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    void* mem = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    auto* header = new (mem) ShmRingHeader();
+    std::memcpy(header->magic, kShmRingMagic, sizeof(kShmRingMagic));
+    header->version = kShmRingVersion;
+    header->headerSize = sizeof(ShmRingHeader);
+    header->capacity = cap;
+    header->writePos.store(0, std::memory_order_relaxed);
+    header->doorbell.store(0, std::memory_order_relaxed);
+    header->waiters.store(0, std::memory_order_relaxed);
+    header->dropped.store(0, std::memory_order_relaxed);
+    header->readPos.store(0, std::memory_order_release);
+
+    // Fault the data area in now so the RX path never page-faults on it
+    std::memset(static_cast<uint8_t*>(mem) + sizeof(ShmRingHeader), 0, cap);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    name_ = name;
+    header_ = header;
+    data_ = static_cast<uint8_t*>(mem) + sizeof(ShmRingHeader);
+    capacity_ = cap;
+    mappedSize_ = total;
+    return true;
+#endif
+}
+
+void ShmRing::removeStale(const std::string& prefix) {
+#ifdef __linux__
+    // POSIX shared memory objects live in /dev/shm, without the leading '/'
+    std::string filePrefix = prefix.substr(prefix.find_first_not_of('/'));
+    DIR* dir = opendir("/dev/shm");
+    if (!dir) return;
+    while (struct dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.compare(0, filePrefix.size(), filePrefix) != 0) continue;
+        std::string pidText = name.substr(filePrefix.size());
+        if (pidText.empty() || pidText.find_first_not_of("0123456789") != std::string::npos) continue;
+        pid_t pid = static_cast<pid_t>(std::strtol(pidText.c_str(), nullptr, 10));
+        if (pid > 0 && kill(pid, 0) != 0 && errno == ESRCH) {
+            shm_unlink(("/" + name).c_str());
+            std::cerr << "[SHM] Removed stale ring /" << name << std::endl;
+        }
+    }
+    closedir(dir);
+#else
+    (void)prefix;
+#endif
+}
+
+void ShmRing::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!header_) return;
+#ifndef _WIN32
+    munmap(header_, mappedSize_);
+    shm_unlink(name_.c_str());
+#endif
+    header_ = nullptr;
+    data_ = nullptr;
+    capacity_ = 0;
+    mappedSize_ = 0;
+}
+
+bool ShmRing::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return header_ != nullptr;
+}
+
+uint64_t ShmRing::dropped() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return header_ ? header_->dropped.load(std::memory_order_relaxed) : 0;
+}
+
+bool ShmRing::write(const std::string& data, const RxTimestamp& ts, uint16_t channel) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!header_) return false;
+
+    size_t need = align8(sizeof(ShmRecordHeader) + data.size());
+    if (need > capacity_ / 2) {
+        header_->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint64_t pos = header_->writePos.load(std::memory_order_relaxed);
+    uint64_t read = header_->readPos.load(std::memory_order_acquire);
+    size_t offset = pos & (capacity_ - 1);
+    size_t tail = capacity_ - offset;
+    size_t skip = tail < need ? tail : 0;
+
+    if (pos + skip + need - read > capacity_) {
+        header_->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (skip) {
+        if (tail >= sizeof(ShmRecordHeader)) {
+            ShmRecordHeader pad{};
+            pad.size = static_cast<uint32_t>(tail);
+            pad.flags = kShmRecordPadding;
+            std::memcpy(data_ + offset, &pad, sizeof(pad));
+        }
+        pos += skip;
+        offset = 0;
+    }
+
+    ShmRecordHeader rec{};
+    rec.size = static_cast<uint32_t>(need);
+    rec.length = static_cast<uint32_t>(data.size());
+    rec.channel = channel;
+    rec.byteTimeNs = ts.byteTimeNs;
+    rec.wakeupNs = ts.wakeupNs;
+    rec.firstByteNs = ts.firstByteNs;
+    std::memcpy(data_ + offset, &rec, sizeof(rec));
+    std::memcpy(data_ + offset + sizeof(rec), data.data(), data.size());
+
+    header_->writePos.store(pos + need, std::memory_order_release);
+
+    // Dekker-style pairing with the consumer's waiters increment: either it
+    // sees the new doorbell value in FUTEX_WAIT or we see it waiting here.
+    header_->doorbell.fetch_add(1, std::memory_order_seq_cst);
+    if (header_->waiters.load(std::memory_order_seq_cst) != 0) {
+        ringDoorbell(&header_->doorbell);
+    }
+    return true;
+}
+
+} // namespace hw_analyzer
@@ -0,0 +1,177 @@
+#include "thread_tuning.hpp"
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <atomic>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+#if defined(__linux__) && defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace hw_analyzer {
+
+namespace {
+
+std::atomic<bool> g_memoryLocked{false};
+
+bool parseCpu(const std::string& text, int& cpu) {
+    char* end = nullptr;
+    long v = std::strtol(text.c_str(), &end, 10);
+    if (end == text.c_str() || *end != '\0' || v < 0 || v > 1023) return false;
+    cpu = static_cast<int>(v);
+    return true;
+}
+
+} // namespace
+
+ThreadPlacement TuningOptions::reader(size_t index) const {
+    ThreadPlacement placement;
+    if (!readerCpus.empty()) {
+        placement.cpu = readerCpus[index < readerCpus.size() ? index : readerCpus.size() - 1];
+    }
+    placement.fifoPriority = rtPriority;
+    return placement;
+}
+
+ThreadPlacement TuningOptions::publisher() const {
+    ThreadPlacement placement;
+    placement.cpu = publisherCpu;
+    return placement;
+}
+
+bool parseTuningOption(const std::string& arg, const char* value, TuningOptions& options,
+                       bool* consumedValue, std::string& error) {
+    *consumedValue = false;
+    if (arg == "--mlock") {
+        options.lockMemory = true;
+        return true;
+    }
+    if (arg != "--reader-cpu" && arg != "--publisher-cpu" && arg != "--rt-priority") {
+        return false;
+    }
+    if (!value) {
+        error = "Missing value for " + arg;
+        return true;
+    }
+    *consumedValue = true;
+
+    if (arg == "--reader-cpu") {
+        options.readerCpus.clear();
+        std::stringstream list(value);
+        std::string item;
+        while (std::getline(list, item, ',')) {
+            int cpu;
+            if (!parseCpu(item, cpu)) {
+                error = "Invalid CPU list";
+                return true;
+            }
+            options.readerCpus.push_back(cpu);
+        }
+    } else if (arg == "--publisher-cpu") {
+        if (!parseCpu(value, options.publisherCpu)) error = "Invalid CPU";
+    } else {
+        char* end = nullptr;
+        long prio = std::strtol(value, &end, 10);
+        if (end == value || *end != '\0' || prio < 1 || prio > 99) {
+            error = "RT priority must be 1-99";
+        } else {
+            options.rtPriority = static_cast<int>(prio);
+        }
+    }
+    return true;
+}
+
+bool applyThreadPlacement(const ThreadPlacement& placement, const std::string& name) {
+    bool ok = true;
+
+#ifdef _WIN32
+    if (placement.cpu >= 0 &&
+        SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << placement.cpu) == 0) {
+        std::cerr << "[Tuning] " << name << ": failed to pin to CPU " << placement.cpu << std::endl;
+        ok = false;
+    }
+    if (placement.fifoPriority > 0 &&
+        !SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL)) {
+        std::cerr << "[Tuning] " << name << ": failed to raise priority" << std::endl;
+        ok = false;
+    }
+#else
+    if (placement.cpu >= 0) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(placement.cpu, &set);
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0) {
+            std::cerr << "[Tuning] " << name << ": failed to pin to CPU " << placement.cpu
+                      << ": " << std::strerror(rc) << std::endl;
+            ok = false;
+        }
+#else
+        std::cerr << "[Tuning] " << name << ": CPU pinning is not supported on this platform" << std::endl;
+        ok = false;
+#endif
+    }
+    if (placement.fifoPriority > 0) {
+        sched_param param{};
+        param.sched_priority = placement.fifoPriority;
+        int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (rc != 0) {
+            std::cerr << "[Tuning] " << name << ": failed to set SCHED_FIFO " << placement.fifoPriority
+                      << ": " << std::strerror(rc) << std::endl;
+            ok = false;
+        }
+    }
+#endif
+
+    if (ok && (placement.cpu >= 0 || placement.fifoPriority > 0)) {
+        std::cerr << "[Tuning] " << name << ":";
+        if (placement.cpu >= 0) std::cerr << " cpu " << placement.cpu;
+        if (placement.fifoPriority > 0) std::cerr << " SCHED_FIFO " << placement.fifoPriority;
+        std::cerr << std::endl;
+    }
+    return ok;
+}
+
+bool lockProcessMemory() {
+#ifdef _WIN32
+    std::cerr << "[Tuning] Memory locking is not supported on Windows" << std::endl;
+    return false;
+#else
+#if defined(__linux__) && defined(__GLIBC__)
+    // Keep freed heap memory mapped and serve large allocations from the
+    // heap, so the allocator does not hand pages back and fault them in again.
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+#endif
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        std::cerr << "[Tuning] mlockall failed: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    g_memoryLocked = true;
+    std::cerr << "[Tuning] Memory locked" << std::endl;
+    return true;
+#endif
+}
+
+bool processMemoryLocked() {
+    return g_memoryLocked;
+}
+
+void prefaultStack() {
+    volatile char stack[64 * 1024];
+    for (size_t i = 0; i < sizeof(stack); i += 4096) {
+        stack[i] = 0;
+    }
+}
+
+} // namespace hw_analyzer
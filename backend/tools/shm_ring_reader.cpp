@@ -0,0 +1,152 @@
+#include "shm_ring_reader.hpp"
+#include <iostream>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+namespace hw_analyzer {
+
+namespace {
+
+// Returns once the word no longer holds expected, on a wake, or on timeout
+void waitDoorbell(std::atomic<uint32_t>* word, uint32_t expected, int timeoutMs) {
+#ifdef __linux__
+    struct timespec timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT, expected,
+            timeoutMs >= 0 ? &timeout : nullptr, nullptr, 0);
+#else
+    // No futex: poll the word
+    for (int waited = 0; timeoutMs < 0 || waited < timeoutMs; waited++) {
+        if (word->load(std::memory_order_seq_cst) != expected) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+#endif
+}
+
+} // namespace
+
+ShmRingReader::~ShmRingReader() {
+    close();
+}
+
+bool ShmRingReader::open(const std::string& name) {
+    close();
+
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        std::cerr << "[SHM] Failed to open " << name << std::endl;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(ShmRingHeader)) {
+        ::close(fd);
+        std::cerr << "[SHM] " << name << " is too small for a ring" << std::endl;
+        return false;
+    }
+    size_t total = static_cast<size_t>(st.st_size);
+    void* mem = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED) {
+        return false;
+    }
+
+    auto* header = static_cast<ShmRingHeader*>(mem);
+    uint64_t cap = header->capacity;
+    if (std::memcmp(header->magic, kShmRingMagic, sizeof(kShmRingMagic)) != 0 ||
+        header->version != kShmRingVersion || header->headerSize != sizeof(ShmRingHeader) ||
+        cap == 0 || (cap & (cap - 1)) != 0 || cap > total - sizeof(ShmRingHeader)) {
+        munmap(mem, total);
+        std::cerr << "[SHM] " << name << " is not a compatible ring" << std::endl;
+        return false;
+    }
+
+    header_ = header;
+    data_ = static_cast<uint8_t*>(mem) + sizeof(ShmRingHeader);
+    capacity_ = static_cast<size_t>(cap);
+    mappedSize_ = total;
+    return true;
+}
+
+void ShmRingReader::close() {
+    if (!header_) return;
+    munmap(header_, mappedSize_);
+    header_ = nullptr;
+    data_ = nullptr;
+    capacity_ = 0;
+    mappedSize_ = 0;
+}
+
+uint64_t ShmRingReader::dropped() const {
+    return header_ ? header_->dropped.load(std::memory_order_relaxed) : 0;
+}
+
+size_t ShmRingReader::drain(const RecordCallback& cb) {
+    if (!header_) return 0;
+
+    size_t count = 0;
+    uint64_t pos = header_->readPos.load(std::memory_order_relaxed);
+    uint64_t end = header_->writePos.load(std::memory_order_acquire);
+    while (pos < end) {
+        size_t offset = pos & (capacity_ - 1);
+        size_t tail = capacity_ - offset;
+        if (tail < sizeof(ShmRecordHeader)) {
+            pos += tail; // Too short for a padding record
+        } else {
+            ShmRecordHeader rec;
+            std::memcpy(&rec, data_ + offset, sizeof(rec));
+            if (rec.size < sizeof(ShmRecordHeader) || rec.size > tail ||
+                (!(rec.flags & kShmRecordPadding) && rec.length > rec.size - sizeof(ShmRecordHeader))) {
+                // Corrupt record: skip everything published so far
+                std::cerr << "[SHM] Corrupt record at " << pos << ", resynchronising" << std::endl;
+                pos = end;
+            } else {
+                if (!(rec.flags & kShmRecordPadding)) {
+                    RxTimestamp ts;
+                    ts.byteTimeNs = rec.byteTimeNs;
+                    ts.wakeupNs = rec.wakeupNs;
+                    ts.firstByteNs = rec.firstByteNs;
+                    cb(std::string(reinterpret_cast<const char*>(data_ + offset + sizeof(rec)), rec.length),
+                       ts, rec.channel);
+                    count++;
+                }
+                pos += rec.size;
+            }
+        }
+        // Release each record's space as soon as it has been consumed
+        header_->readPos.store(pos, std::memory_order_release);
+    }
+    return count;
+}
+
+bool ShmRingReader::wait(int timeoutMs) {
+    if (!header_) return false;
+
+    // Counterpart of the producer's doorbell increment: sample the doorbell,
+    // announce ourselves, then re-check before sleeping, so a record
+    // published in between either shows up here or changes the doorbell.
+    uint32_t bell = header_->doorbell.load(std::memory_order_seq_cst);
+    header_->waiters.fetch_add(1, std::memory_order_seq_cst);
+    bool pending = header_->writePos.load(std::memory_order_seq_cst) !=
+                   header_->readPos.load(std::memory_order_relaxed);
+    if (!pending) {
+        waitDoorbell(&header_->doorbell, bell, timeoutMs);
+        pending = header_->writePos.load(std::memory_order_acquire) !=
+                  header_->readPos.load(std::memory_order_relaxed);
+    }
+    header_->waiters.fetch_sub(1, std::memory_order_seq_cst);
+    return pending;
+}
+
+} // namespace hw_analyzer
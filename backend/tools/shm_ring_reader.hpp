@@ -0,0 +1,45 @@
+#pragma once
+
+#include "shm_ring.hpp"
+#include <string>
+#include <cstdint>
+#include <functional>
+
+namespace hw_analyzer {
+
+// Consumer side of the shared-memory RX ring: maps a ring created by
+// ShmRing and follows the doorbell protocol documented in shm_ring.hpp.
+// Single consumer per ring. Linux/macOS only.
+class ShmRingReader {
+public:
+    using RecordCallback = std::function<void(const std::string& data, const RxTimestamp& ts, uint16_t channel)>;
+
+    ShmRingReader() = default;
+    ~ShmRingReader();
+
+    ShmRingReader(const ShmRingReader&) = delete;
+    ShmRingReader& operator=(const ShmRingReader&) = delete;
+
+    bool open(const std::string& name);
+    void close();
+    bool isOpen() const { return header_ != nullptr; }
+
+    size_t capacity() const { return capacity_; }
+    uint64_t dropped() const;
+
+    // Deliver every published record and release its space; returns the
+    // number of records delivered.
+    size_t drain(const RecordCallback& cb);
+
+    // Sleep until the producer publishes or timeoutMs elapses. Returns true
+    // if records are pending.
+    bool wait(int timeoutMs);
+
+private:
+    ShmRingHeader* header_ = nullptr;
+    uint8_t* data_ = nullptr;
+    size_t capacity_ = 0;
+    size_t mappedSize_ = 0;
+};
+
+} // namespace hw_analyzer
@@ -0,0 +1,255 @@
+// Reference consumer for the shared-memory RX ring.
+//
+//   hw_analyzer_shm_tail [--port N] [--size BYTES] [--raw] [--duration SEC]
+//
+// Connects to a running backend on localhost, asks for the ring with
+// {"cmd": "shm"}, then drains it with ShmRingReader until interrupted.
+// --raw writes the payload bytes to stdout; a throughput summary goes to
+// stderr once a second. The WebSocket connection stays open while the ring
+// is read, as the backend releases the ring when its client disconnects.
+
+#include "shm_ring_reader.hpp"
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <csignal>
+#include <atomic>
+#include <chrono>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace hw_analyzer;
+
+namespace {
+
+std::atomic<bool> g_stop{false};
+
+void onSignal(int) {
+    g_stop = true;
+}
+
+bool sendAll(int sock, const std::string& data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+        ssize_t n = send(sock, data.data() + offset, data.size() - offset, 0);
+        if (n <= 0) return false;
+        offset += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Client frames must be masked; a zero mask keeps the payload readable
+bool sendText(int sock, const std::string& text) {
+    std::string frame;
+    frame.push_back(static_cast<char>(0x81));
+    if (text.size() < 126) {
+        frame.push_back(static_cast<char>(0x80 | text.size()));
+    } else {
+        frame.push_back(static_cast<char>(0x80 | 126));
+        frame.push_back(static_cast<char>((text.size() >> 8) & 0xFF));
+        frame.push_back(static_cast<char>(text.size() & 0xFF));
+    }
+    frame.append(4, '\0');
+    frame += text;
+    return sendAll(sock, frame);
+}
+
+class Connection {
+public:
+    ~Connection() {
+        if (sock_ >= 0) ::close(sock_);
+    }
+
+    bool open(int port) {
+        sock_ = socket(AF_INET, SOCK_STREAM, 0);
+        if (sock_ < 0) return false;
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(sock_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) return false;
+
+        std::string request =
+            "GET / HTTP/1.1\r\n"
+            "Host: localhost\r\n"
+            "Upgrade: websocket\r\n"
+            "Connection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n\r\n";
+        if (!sendAll(sock_, request)) return false;
+        while (buffer_.find("\r\n\r\n") == std::string::npos) {
+            if (!fill()) return false;
+        }
+        bool upgraded = buffer_.compare(0, 12, "HTTP/1.1 101") == 0;
+        buffer_.erase(0, buffer_.find("\r\n\r\n") + 4);
+        return upgraded;
+    }
+
+    bool send(const std::string& text) { return sendText(sock_, text); }
+
+    // Next text message from the server (server frames are unmasked)
+    bool receive(std::string& message) {
+        while (true) {
+            if (buffer_.size() >= 2) {
+                size_t length = static_cast<uint8_t>(buffer_[1]) & 0x7F;
+                size_t header = 2;
+                if (length == 126 && buffer_.size() >= 4) {
+                    length = (static_cast<uint8_t>(buffer_[2]) << 8) | static_cast<uint8_t>(buffer_[3]);
+                    header = 4;
+                } else if (length == 127 && buffer_.size() >= 10) {
+                    length = 0;
+                    for (int i = 2; i < 10; i++) length = (length << 8) | static_cast<uint8_t>(buffer_[i]);
+                    header = 10;
+                }
+                if (length < 126 || header > 2) {
+                    if (buffer_.size() >= header + length) {
+                        message = buffer_.substr(header, length);
+                        buffer_.erase(0, header + length);
+                        return true;
+                    }
+                }
+            }
+            if (!fill()) return false;
+        }
+    }
+
+private:
+    bool fill() {
+        char chunk[4096];
+        ssize_t n = recv(sock_, chunk, sizeof(chunk), 0);
+        if (n <= 0) return false;
+        buffer_.append(chunk, static_cast<size_t>(n));
+        return true;
+    }
+
+    int sock_ = -1;
+    std::string buffer_;
+};
+
+// Value of "key":"..." in a flat JSON reply
+std::string jsonString(const std::string& msg, const std::string& key) {
+    size_t pos = msg.find("\"" + key + "\":\"");
+    if (pos == std::string::npos) return "";
+    pos += key.size() + 4;
+    return msg.substr(pos, msg.find('"', pos) - pos);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int port = 9001;
+    long long size = 16 * 1024 * 1024;
+    bool raw = false;
+    double duration = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--raw") {
+            raw = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Error: Missing value for " << arg << std::endl;
+            return 2;
+        }
+        const char* value = argv[++i];
+        char* end = nullptr;
+        if (arg == "--port") {
+            port = static_cast<int>(std::strtol(value, &end, 10));
+            if (*end != '\0' || port <= 0 || port > 65535) {
+                std::cerr << "Error: Invalid port" << std::endl;
+                return 2;
+            }
+        } else if (arg == "--size") {
+            size = std::strtoll(value, &end, 10);
+            if (*end != '\0' || size <= 0) {
+                std::cerr << "Error: Invalid ring size" << std::endl;
+                return 2;
+            }
+        } else if (arg == "--duration") {
+            duration = std::strtod(value, &end);
+            if (*end != '\0' || duration < 0) {
+                std::cerr << "Error: Invalid duration" << std::endl;
+                return 2;
+            }
+        } else {
+            std::cerr << "Error: Unknown option " << arg << std::endl;
+            return 2;
+        }
+    }
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+
+    Connection connection;
+    if (!connection.open(port)) {
+        std::cerr << "[Tail] Failed to connect to the backend on port " << port << std::endl;
+        return 1;
+    }
+    connection.send(R"({"cmd":"shm","enable":true,"size":)" + std::to_string(size) + "}");
+
+    // Until the reply arrives the connection still receives everything
+    std::string reply;
+    do {
+        if (!connection.receive(reply)) {
+            std::cerr << "[Tail] Backend closed the connection" << std::endl;
+            return 1;
+        }
+    } while (reply.find(R"("type":"shm")") == std::string::npos &&
+             reply.find(R"("type":"error")") == std::string::npos);
+    if (reply.find(R"("type":"error")") != std::string::npos) {
+        std::cerr << "[Tail] " << jsonString(reply, "message") << std::endl;
+        return 1;
+    }
+
+    ShmRingReader reader;
+    std::string name = jsonString(reply, "name");
+    if (!reader.open(name)) {
+        return 1;
+    }
+    std::cerr << "[Tail] Reading " << name << " (" << reader.capacity() << " bytes)" << std::endl;
+
+    using Clock = std::chrono::steady_clock;
+    auto start = Clock::now();
+    auto lastReport = start;
+    uint64_t records = 0, bytes = 0, wakeups = 0;
+    uint64_t reportBytes = 0;
+    bool writeFailed = false;
+    while (!g_stop && !writeFailed) {
+        reader.drain([&](const std::string& data, const RxTimestamp&, uint16_t) {
+            records++;
+            bytes += data.size();
+            if (raw && std::fwrite(data.data(), 1, data.size(), stdout) != data.size()) {
+                writeFailed = true;
+            }
+        });
+        if (raw) std::fflush(stdout);
+
+        auto now = Clock::now();
+        double elapsed = std::chrono::duration<double>(now - start).count();
+        if (duration > 0 && elapsed >= duration) break;
+        if (now - lastReport >= std::chrono::seconds(1)) {
+            double seconds = std::chrono::duration<double>(now - lastReport).count();
+            std::fprintf(stderr, "[Tail] %llu records, %.1f KiB/s, %llu doorbell wakeups, %llu dropped by the backend\n",
+                         static_cast<unsigned long long>(records),
+                         (bytes - reportBytes) / 1024.0 / seconds,
+                         static_cast<unsigned long long>(wakeups),
+                         static_cast<unsigned long long>(reader.dropped()));
+            lastReport = now;
+            reportBytes = bytes;
+        }
+
+        if (reader.wait(100)) wakeups++;
+    }
+
+    std::fprintf(stderr, "[Tail] Total: %llu records, %llu bytes, %llu dropped by the backend\n",
+                 static_cast<unsigned long long>(records), static_cast<unsigned long long>(bytes),
+                 static_cast<unsigned long long>(reader.dropped()));
+    reader.close();
+    connection.send(R"({"cmd":"shm","enable":false})");
+    return writeFailed ? 1 : 0;
+}
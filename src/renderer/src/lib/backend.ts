@@ -5,10 +5,26 @@ export interface SerialPortInfo {
 	desc: string;
 }
 
+export interface Subscription {
+	types?: string[];
+	ports?: string[];
+	channels?: number[];
+	bytes?: [number, number];
+	regex?: string;
+}
+
 export interface WebSocketMessage {
-	type: 'ports' | 'rx' | 'status' | 'error';
+	type: 'ports' | 'rx' | 'status' | 'error' | 'stats';
 	data?: SerialPortInfo[] | string;
 	message?: string;
+	port?: string;
+	channel?: number;
+	// RX timing, backend monotonic clock in microseconds
+	ts?: number;
+	t0?: number;
+	byteNs?: number;
+	// In the open reply: wall clock (epoch microseconds) minus the RX clock
+	clockOffsetUs?: number;
 }
 
 type MessageCallback = (message: WebSocketMessage) => void;
@@ -123,6 +139,27 @@ class BackendClient {
 	writeData(data: string) {
 		this.send({ cmd: 'write', data });
 	}
+
+	subscribe(subscription: Subscription) {
+		this.send({ cmd: 'subscribe', ...subscription });
+	}
+
+	unsubscribe() {
+		this.send({ cmd: 'unsubscribe' });
+	}
+
+	requestStats() {
+		this.send({ cmd: 'stats' });
+	}
+
+	// path is relative to the backend's capture directory
+	startRecording(path: string, codec: 'lz4' | 'zstd' | 'none' = 'lz4') {
+		this.send({ cmd: 'record', path, codec });
+	}
+
+	stopRecording() {
+		this.send({ cmd: 'stop_record' });
+	}
 }
 
 // Export singleton instance